@@ -104,6 +104,8 @@ CONSUMER_REPORT __attribute__((aligned(16))) consumerReport USB_ALIGN;
 
 #if APP_HAS_MOUSE_INTERFACE
 MOUSE_REPORT __attribute__((aligned(16))) mouseReport USB_ALIGN;
+/* Resolution Multiplier feature report */
+uint8_t __attribute__((aligned(16))) mouseFeatureReport USB_ALIGN;
 #endif
 
 // *****************************************************************************
@@ -186,6 +188,54 @@ USB_DEVICE_HID_EVENT_RESPONSE APP_USBDeviceHIDEventHandler
         case USB_DEVICE_HID_EVENT_CONTROL_TRANSFER_DATA_SENT:
             break;
 
+#if APP_HAS_MOUSE_INTERFACE
+        case USB_DEVICE_HID_EVENT_GET_REPORT:
+
+            /* Only the mouse interface has a feature report. The requests to
+               the other interfaces are left as they were. */
+            if (hidInstance != HID_INDEX_MOUSE)
+            {
+                break;
+            }
+            if (((USB_DEVICE_HID_EVENT_DATA_GET_REPORT*)eventData)->reportType == USB_HID_REPORT_TYPE_FEATURE)
+            {
+                mouseFeatureReport = MOUSE_GetFeature();
+                USB_DEVICE_ControlSend(appDataObject->deviceHandle, &mouseFeatureReport, sizeof mouseFeatureReport);
+            }
+            else
+            {
+                USB_DEVICE_ControlStatus(appDataObject->deviceHandle, USB_DEVICE_CONTROL_STATUS_ERROR);
+            }
+            break;
+
+        case USB_DEVICE_HID_EVENT_SET_REPORT:
+
+            if (hidInstance != HID_INDEX_MOUSE)
+            {
+                break;
+            }
+            if (((USB_DEVICE_HID_EVENT_DATA_SET_REPORT*)eventData)->reportType == USB_HID_REPORT_TYPE_FEATURE)
+            {
+                /* The feature report is applied when the data stage completes
+                   with USB_DEVICE_HID_EVENT_CONTROL_TRANSFER_DATA_RECEIVED. */
+                USB_DEVICE_ControlReceive(appDataObject->deviceHandle, &mouseFeatureReport, sizeof mouseFeatureReport);
+            }
+            else
+            {
+                USB_DEVICE_ControlStatus(appDataObject->deviceHandle, USB_DEVICE_CONTROL_STATUS_ERROR);
+            }
+            break;
+
+        case USB_DEVICE_HID_EVENT_CONTROL_TRANSFER_DATA_RECEIVED:
+
+            if (hidInstance == HID_INDEX_MOUSE)
+            {
+                MOUSE_SetFeature(mouseFeatureReport);
+                USB_DEVICE_ControlStatus(appDataObject->deviceHandle, USB_DEVICE_CONTROL_STATUS_OK);
+            }
+            break;
+#endif
+
         default:
             break;
     }
@@ -237,6 +287,10 @@ void APP_USBDeviceEventHandler(USB_DEVICE_EVENT event,
             appData.isConfigured = false;
             appData.state = APP_STATE_WAIT_FOR_CONFIGURATION;
 
+#if APP_HAS_MOUSE_INTERFACE
+            /* The host sets the Resolution Multiplier again after enumeration */
+            MOUSE_SetFeature(0);
+#endif
             KEYBOARD_EnableLED(false);
             KEYBOARD_SetLEDs(0);
             break;
@@ -467,6 +521,8 @@ void APP_Tasks ( void )
 
             if(appData.isConfigured)
             {
+                /* This pass sends the reports updated so far */
+                appData.reportsUpdated = false;
                 appData.state = APP_STATE_CHECK_FOR_OUTPUT_REPORT;
             }
             else
@@ -555,7 +611,7 @@ void APP_Tasks ( void )
             if(instance->isReportSentComplete && instance->idleTimer == 0)
             {
                 /* This means we can send the mouse report. */
-                if (MOUSE_GetReport(mouseReport.data)) {
+                if (MOUSE_GetUSBReport(mouseReport.data)) {
                     instance->isReportSentComplete = false;
                     instance->idleTimer = instance->idleRate * APP_USB_CONVERT_TO_MILLISECOND;
                     USB_DEVICE_HID_ReportSend(instance->hidInstance,
@@ -755,6 +811,32 @@ uint16_t APP_GetTick( void )
     return appData.tick;
 }
 
+/******************************************************************************
+  Function:
+    uint32_t APP_GetMicroseconds ( void )
+
+  Description:
+    This function returns the time since power-up in microseconds.
+    SYS_TIME_Counter64Get() only counts the TC3 overflows, i.e., the TC3
+    periods of CC0 + 1 counts each, so the TC3 counter is added to get the
+    2048 Hz count (see TC3_TimerFrequencyGet()). 1000000 / 2048 reduces to
+    15625 / 32, so no division is needed.
+ */
+
+uint32_t APP_GetMicroseconds( void )
+{
+    uint64_t overflows;
+    uint16_t count;
+
+    // Read again if TC3 overflowed while reading the counter.
+    do {
+        overflows = SYS_TIME_Counter64Get();
+        count = TC3_Timer16bitCounterGet();
+    } while (overflows != SYS_TIME_Counter64Get());
+    overflows = overflows * (TC3_Timer16bitPeriodGet() + 1u) + count;
+    return (uint32_t) ((overflows * 15625u) >> 5);
+}
+
 /******************************************************************************
   Function:
     void APP_WakeUp ( void )
@@ -784,6 +866,25 @@ bool APP_Suspended( void )
     return appData.state == APP_STATE_MCU_ON_STANDBY;
 }
 
+bool APP_IsIdle( void )
+{
+    return appData.state == APP_STATE_CHECK_IF_CONFIGURED && !appData.reportsUpdated;
+}
+
+/*******************************************************************************
+  Function:
+    void APP_ReportsUpdated ( void )
+
+  Description:
+    This function keeps APP_IsIdle() false until a pass of the report state
+    machine started after this call has completed.
+ */
+
+void APP_ReportsUpdated( void )
+{
+    appData.reportsUpdated = true;
+}
+
 /*******************************************************************************
  End of File
  */
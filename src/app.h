@@ -81,6 +81,7 @@
 #include "eeprom.h"
 #include "macro.h"
 #include "profile.h"
+#include "recorder.h"
 #include "hos_master.h"
 #include "tsap.h"
 #include "utils.h"
@@ -206,6 +207,9 @@ typedef struct {
     /* Current tick count */
     volatile uint16_t tick;
 
+    /* Reports updated since the current pass of the state machine started */
+    bool reportsUpdated;
+
     /*
      * USB device state
      */
@@ -374,6 +378,46 @@ void APP_ResetTick(void);
  */
 uint16_t APP_GetTick(void);
 
+/*******************************************************************************
+  Function:
+    uint32_t APP_GetMicroseconds ( void )
+
+  Summary:
+    Retrieves a free-running monotonic time stamp in microseconds.
+
+  Description:
+    This function combines the TC3 overflow count kept by SYS_TIME with the
+    TC3 counter, which counts at 2048 Hz, and converts the result into
+    microseconds. Unlike APP_GetTick(), the time stamp is not reset by
+    APP_ResetTick().
+
+  Precondition:
+    The system and application initialization ("SYS_Initialize") should be
+    called before calling this function.
+
+  Parameters:
+    None.
+
+  Returns:
+    uint32_t - The time since power-up in microseconds, which wraps around
+               after about 71.6 minutes.
+
+  Example:
+    <code>
+    uint32_t start = APP_GetMicroseconds();
+    ...
+    uint32_t elapsed = APP_GetMicroseconds() - start;
+    </code>
+
+  Remarks:
+    Compare time stamps by the unsigned difference so that the wrap-around
+    is handled. TC3 runs at 2048 Hz to keep counting in the standby mode,
+    so the time stamp advances in steps of about 488 microseconds. Do not
+    call this function with interrupts disabled, as a pending TC3 overflow
+    would then be missed.
+ */
+uint32_t APP_GetMicroseconds(void);
+
 /*******************************************************************************
   Function:
     void APP_WakeUp(void)
@@ -442,6 +486,79 @@ void APP_WakeUp(void);
  */
 bool APP_Suspended(void);
 
+/*******************************************************************************
+  Function:
+    bool APP_IsIdle(void)
+
+  Summary:
+    Checks if the application state machine has nothing to do until the next
+    interrupt.
+
+  Description:
+    This function returns true when the application has completed a pass of
+    its report state machine while the USB device is configured, and no
+    report has been updated by APP_ReportsUpdated() since the pass started.
+    Every further event, such as a completed report transfer, a USB SOF or a
+    timer tick, is signaled by an interrupt.
+
+  Precondition:
+    The system and application initialization ("SYS_Initialize") should
+    be called before calling this function.
+
+  Parameters:
+    None.
+
+  Returns:
+    - true: if the CPU can sleep until the next interrupt.
+    - false: if APP_Tasks() should be called again.
+
+  Example:
+    <code>
+    if (APP_IsIdle()) {
+        PM_IdleModeEnter();
+    }
+    </code>
+
+  Remarks:
+    Interrupts should be disabled while checking this function and entering
+    the sleep mode so that no event is missed.
+ */
+bool APP_IsIdle(void);
+
+/*******************************************************************************
+  Function:
+    void APP_ReportsUpdated(void)
+
+  Summary:
+    Notifies the application that the reports may have been updated.
+
+  Description:
+    This function makes APP_IsIdle() return false until the report state
+    machine has completed a pass started after this call, so that the updated
+    reports are sent before the CPU sleeps.
+
+  Precondition:
+    The system and application initialization ("SYS_Initialize") should
+    be called before calling this function.
+
+  Parameters:
+    None.
+
+  Returns:
+    None.
+
+  Example:
+    <code>
+    KEYBOARD_Task();
+    APP_ReportsUpdated();
+    </code>
+
+  Remarks:
+    This function should be called from the main loop, not from an interrupt
+    handler.
+ */
+void APP_ReportsUpdated(void);
+
 //DOM-IGNORE-BEGIN
 #ifdef __cplusplus
 }
@@ -73,12 +73,47 @@ static const uint8_t hid_rpt2[] =
     0x05, 0x01, /*      Usage Page (Generic Desktop)        */
     0x09, 0x30, /*      Usage (X)                           */
     0x09, 0x31, /*      Usage (Y)                           */
-    0x09, 0x38, /*      Usage (Wheel)                       */
-    0x15, 0x81, /*      Logical Minimum (-127)              */
-    0x25, 0x7F, /*      Logical Maximum (127)               */
-    0x75, 0x08, /*      Report Size (8)                     */
-    0x95, 0x03, /*      Report Count (3)                    */
+    0x16, 0x01, 0x80, /* Logical Minimum (-32767)           */
+    0x26, 0xFF, 0x7F, /* Logical Maximum (32767)            */
+    0x75, 0x10, /*      Report Size (16)                    */
+    0x95, 0x02, /*      Report Count (2)                    */
     0x81, 0x06, /*      Input (Data, Variable, Relative)    */
+    0xA1, 0x02, /*      Collection (Logical)                */
+    0x09, 0x48, /*          Usage (Resolution Multiplier)   */
+    0x15, 0x00, /*          Logical Minimum (0)             */
+    0x25, 0x01, /*          Logical Maximum (1)             */
+    0x35, 0x01, /*          Physical Minimum (1)            */
+    0x45, 0x08, /*          Physical Maximum (8)            */
+    0x75, 0x02, /*          Report Size (2)                 */
+    0x95, 0x01, /*          Report Count (1)                */
+    0xB1, 0x02, /*          Feature (Data, Variable, Absolute) */
+    0x35, 0x00, /*          Physical Minimum (0)            */
+    0x45, 0x00, /*          Physical Maximum (0)            */
+    0x09, 0x38, /*          Usage (Wheel)                   */
+    0x15, 0x81, /*          Logical Minimum (-127)          */
+    0x25, 0x7F, /*          Logical Maximum (127)           */
+    0x75, 0x08, /*          Report Size (8)                 */
+    0x81, 0x06, /*          Input (Data, Variable, Relative) */
+    0xC0,       /*      End Collection                      */
+    0xA1, 0x02, /*      Collection (Logical)                */
+    0x09, 0x48, /*          Usage (Resolution Multiplier)   */
+    0x15, 0x00, /*          Logical Minimum (0)             */
+    0x25, 0x01, /*          Logical Maximum (1)             */
+    0x35, 0x01, /*          Physical Minimum (1)            */
+    0x45, 0x08, /*          Physical Maximum (8)            */
+    0x75, 0x02, /*          Report Size (2)                 */
+    0xB1, 0x02, /*          Feature (Data, Variable, Absolute) */
+    0x35, 0x00, /*          Physical Minimum (0)            */
+    0x45, 0x00, /*          Physical Maximum (0)            */
+    0x75, 0x04, /*          Report Size (4)                 */
+    0xB1, 0x01, /*          Feature (Constant) ;4 bit padding */
+    0x05, 0x0C, /*          Usage Page (Consumer Devices)   */
+    0x0A, 0x38, 0x02, /*    Usage (AC Pan)                  */
+    0x15, 0x81, /*          Logical Minimum (-127)          */
+    0x25, 0x7F, /*          Logical Maximum (127)           */
+    0x75, 0x08, /*          Report Size (8)                 */
+    0x81, 0x06, /*          Input (Data, Variable, Relative) */
+    0xC0,       /*      End Collection                      */
     0xC0, 0xC0  /* End Collection,End Collection            */
 };
 
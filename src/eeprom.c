@@ -17,8 +17,6 @@
 #include "definitions.h"
 #include "eeprom.h"
 
-#define NVRAM_SIZE      1024
-#define NVRAM_ADDRESS   (0x40000 - NVRAM_SIZE)
 #define PAGE_SIZE       NVMCTRL_FLASH_PAGESIZE      // 64 bytes
 #define SECTOR_SIZE     NVMCTRL_FLASH_ROWSIZE       // 256 ybtes
 #define MAX_SECTORS     (NVRAM_SIZE / SECTOR_SIZE)
@@ -19,6 +19,9 @@
 
 #include <stddef.h>
 
+#define NVRAM_SIZE      1024
+#define NVRAM_ADDRESS   (0x40000 - NVRAM_SIZE)
+
 void EEPROM_Initialize(void);
 
 int EEPROM_Read(size_t offset, void* buffer, size_t count);
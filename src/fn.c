@@ -55,6 +55,7 @@ static uint8_t const kanaKeys[KANA_MAX + 1][MAX_KANA_KEY_NAME] =
     {KEY_X, KEY_6, KEY_0, KEY_0, KEY_4, KEY_ENTER, 0},
     {KEY_M, KEY_T, KEY_Y, KEY_P, KEY_E, KEY_ENTER, 0},
     {KEY_N, KEY_E, KEY_W, KEY_ENTER, 0},
+    {KEY_U, KEY_S, KEY_E, KEY_R, KEY_ENTER, 0},
 };
 
 #define MAX_DELAY_KEY_NAME  5
@@ -118,6 +119,42 @@ static uint8_t const prefixKeys[PREFIXSHIFT_MAX + 1][MAX_PREFIX_KEY_NAME] =
     {KEY_L, KEY_E, KEY_D, KEY_ENTER, 0},
 };
 
+#define MAX_PACE_KEY_NAME   6
+
+static uint8_t const paceKeys[PACE_MAX + 1][MAX_PACE_KEY_NAME] =
+{
+    {KEY_F, KEY_A, KEY_S, KEY_T, KEY_ENTER, 0},
+    {KEY_S, KEY_A, KEY_F, KEY_E, KEY_ENTER, 0},
+};
+
+#define MAX_KANA_OUTPUT_KEY_NAME    6
+
+static uint8_t const kanaOutputKeys[KANA_OUTPUT_MAX + 1][MAX_KANA_OUTPUT_KEY_NAME] =
+{
+    {KEY_R, KEY_O, KEY_M, KEY_A, KEY_ENTER, 0},
+    {KEY_J, KEY_I, KEY_S, KEY_ENTER, 0},
+};
+
+#define MAX_LOOKAHEAD_KEY_NAME  6
+
+static uint8_t const lookaheadKeys[LOOKAHEAD_MAX + 1][MAX_LOOKAHEAD_KEY_NAME] =
+{
+    {KEY_L, KEY_0, KEY_ENTER, 0},
+    {KEY_L, KEY_1, KEY_0, KEY_0, KEY_ENTER, 0},
+    {KEY_L, KEY_2, KEY_0, KEY_0, KEY_ENTER, 0},
+    {KEY_L, KEY_3, KEY_0, KEY_0, KEY_ENTER, 0},
+};
+
+#define MAX_CHORD_KEY_NAME  6
+
+static uint8_t const chordKeys[CHORD_MAX + 1][MAX_CHORD_KEY_NAME] =
+{
+    {KEY_W, KEY_0, KEY_ENTER, 0},
+    {KEY_W, KEY_5, KEY_0, KEY_ENTER, 0},
+    {KEY_W, KEY_7, KEY_5, KEY_ENTER, 0},
+    {KEY_W, KEY_1, KEY_0, KEY_0, KEY_ENTER, 0},
+};
+
 static const uint8_t aboutTitle[] = {
     KEY_E, KEY_S, KEY_R, KEY_I, KEY_L, KEY_L, KEY_E, KEY_SPACE,
     KEY_N, KEY_I, KEY_S, KEY_S, KEY_E,
@@ -173,6 +210,22 @@ static const uint8_t aboutF9[] = {
     KEY_F, KEY_9, KEY_SPACE, 0
 };
 
+static const uint8_t aboutShiftF5[] = {
+    KEY_S, KEY_MINUS, KEY_F, KEY_5, KEY_SPACE, 0
+};
+
+static const uint8_t aboutShiftF10[] = {
+    KEY_S, KEY_MINUS, KEY_F, KEY_1, KEY_0, KEY_SPACE, 0
+};
+
+static const uint8_t aboutShiftF11[] = {
+    KEY_S, KEY_MINUS, KEY_F, KEY_1, KEY_1, KEY_SPACE, 0
+};
+
+static const uint8_t aboutShiftF12[] = {
+    KEY_S, KEY_MINUS, KEY_F, KEY_1, KEY_2, KEY_SPACE, 0
+};
+
 static const uint8_t aboutBLE[] = {
     KEY_B, KEY_L, KEY_E, KEY_SPACE, KEY_M, KEY_O, KEY_D, KEY_U, KEY_L, KEY_E,
     KEY_ENTER, 0
@@ -296,6 +349,22 @@ static void DoAbout(void) {
     MACRO_Puts(aboutF9);
     MACRO_Puts(prefixKeys[PROFILE_Read(EEPROM_PREFIX)]);
 
+    // Shift-F5 Macro Pace
+    MACRO_Puts(aboutShiftF5);
+    MACRO_Puts(paceKeys[PROFILE_Read(EEPROM_PACE)]);
+
+    // Shift-F10 Kana Output
+    MACRO_Puts(aboutShiftF10);
+    MACRO_Puts(kanaOutputKeys[PROFILE_Read(EEPROM_KANA_OUTPUT)]);
+
+    // Shift-F11 Dakuten Lookahead
+    MACRO_Puts(aboutShiftF11);
+    MACRO_Puts(lookaheadKeys[PROFILE_Read(EEPROM_LOOKAHEAD)]);
+
+    // Shift-F12 NICOLA Chord Window
+    MACRO_Puts(aboutShiftF12);
+    MACRO_Puts(chordKeys[PROFILE_Read(EEPROM_CHORD)]);
+
 #if APP_HAS_MOUSE_INTERFACE
     MOUSE_About();
 #endif
@@ -328,7 +397,15 @@ int8_t KEYBOARD_GetFnReport(uint8_t keycode)
         MACRO_Puts(baseKeys[value]);
         break;
     case KEY_F4:
-        value = IncrementProfileSetting(EEPROM_KANA, KANA_MAX);
+        // Skip KANA_USER without a user layout, writing the flash only once.
+        value = PROFILE_Read(EEPROM_KANA) + 1;
+        if (value == KANA_USER && !KEYBOARD_HasUserKanaLayout()) {
+            ++value;
+        }
+        if (KANA_MAX < value) {
+            value = 0;
+        }
+        PROFILE_Write(EEPROM_KANA, value);
         MACRO_Puts(kanaKeys[value]);
         break;
     case KEY_F5:
@@ -356,3 +433,46 @@ int8_t KEYBOARD_GetFnReport(uint8_t keycode)
     }
     return XMIT_MACRO;
 }
+
+int8_t KEYBOARD_GetFnShiftReport(uint8_t keycode)
+{
+    uint8_t value;
+
+    switch (keycode) {
+    case KEY_F5:
+        value = IncrementProfileSetting(EEPROM_PACE, PACE_MAX);
+        MACRO_Puts(paceKeys[value]);
+        break;
+    case KEY_F6:
+    case KEY_F7:
+        // Either key stops the recording in progress. The Scroll Lock LED
+        // blinks while recording so that no message gets recorded.
+        if (RECORDER_IsRecording()) {
+            RECORDER_Stop();
+        } else {
+            RECORDER_Start(keycode - KEY_F6);
+        }
+        return XMIT_NONE;
+    case KEY_F8:
+    case KEY_F9:
+        if (RECORDER_IsRecording() || !RECORDER_Play(keycode - KEY_F8)) {
+            return XMIT_NONE;
+        }
+        break;
+    case KEY_F10:
+        value = IncrementProfileSetting(EEPROM_KANA_OUTPUT, KANA_OUTPUT_MAX);
+        MACRO_Puts(kanaOutputKeys[value]);
+        break;
+    case KEY_F11:
+        value = IncrementProfileSetting(EEPROM_LOOKAHEAD, LOOKAHEAD_MAX);
+        MACRO_Puts(lookaheadKeys[value]);
+        break;
+    case KEY_F12:
+        value = IncrementProfileSetting(EEPROM_CHORD, CHORD_MAX);
+        MACRO_Puts(chordKeys[value]);
+        break;
+    default:
+        return XMIT_NONE;
+    }
+    return XMIT_MACRO;
+}
@@ -363,13 +363,77 @@ static uint8_t ansiToJIS[5][2] = {
     {KEY_0, KEY_9}
 };
 
+//
+// JIS kana input mode
+//
+
+// ROMA_NONE - ROMA_L: the JIS kana key for each kana, followed by ゛ or ゜ for
+// the voiced kana. The small kana are typed with Shift.
+static const uint8_t jisKanaSet[ROMA_ANN][2] =
+{
+    {0}, {KEY_3}, {KEY_E}, {KEY_4}, {KEY_5}, {KEY_6}, {0},    // vowels
+    {0}, {KEY_T}, {KEY_G}, {KEY_H}, {KEY_APOSTROPHE}, {KEY_B}, {0},    // K
+    {0}, {KEY_X}, {KEY_D}, {KEY_R}, {KEY_P}, {KEY_C}, {0},    // S
+    {0}, {KEY_Q}, {KEY_A}, {KEY_Z}, {KEY_W}, {KEY_S}, {0},    // T
+    {0}, {KEY_U}, {KEY_I}, {KEY_1}, {KEY_COMMA}, {KEY_K}, {0},    // N
+    {0}, {KEY_F}, {KEY_V}, {KEY_2}, {KEY_EQUAL}, {KEY_MINUS}, {0},    // H
+    {0}, {KEY_J}, {KEY_N}, {KEY_NON_US_HASH}, {KEY_SLASH}, {KEY_M}, {0},    // M
+    {0}, {KEY_7}, {0}, {KEY_8}, {0}, {KEY_9}, {0},    // Y
+    {0}, {KEY_O}, {KEY_L}, {KEY_PERIOD}, {KEY_SEMICOLON}, {KEY_INTERNATIONAL1}, {0},    // R
+    {0}, {KEY_0}, {0}, {KEY_4}, {0}, {KEY_LEFT_SHIFT, KEY_0}, {0},    // W
+    {0}, {KEY_F, KEY_RIGHT_BRACKET}, {KEY_V, KEY_RIGHT_BRACKET}, {KEY_2, KEY_RIGHT_BRACKET}, {KEY_EQUAL, KEY_RIGHT_BRACKET}, {KEY_MINUS, KEY_RIGHT_BRACKET}, {0},    // P
+    {0}, {KEY_T, KEY_LEFT_BRACKET}, {KEY_G, KEY_LEFT_BRACKET}, {KEY_H, KEY_LEFT_BRACKET}, {KEY_APOSTROPHE, KEY_LEFT_BRACKET}, {KEY_B, KEY_LEFT_BRACKET}, {0},    // G
+    {0}, {KEY_X, KEY_LEFT_BRACKET}, {KEY_D, KEY_LEFT_BRACKET}, {KEY_R, KEY_LEFT_BRACKET}, {KEY_P, KEY_LEFT_BRACKET}, {KEY_C, KEY_LEFT_BRACKET}, {0},    // Z
+    {0}, {KEY_Q, KEY_LEFT_BRACKET}, {KEY_A, KEY_LEFT_BRACKET}, {KEY_Z, KEY_LEFT_BRACKET}, {KEY_W, KEY_LEFT_BRACKET}, {KEY_S, KEY_LEFT_BRACKET}, {0},    // D
+    {0}, {KEY_F, KEY_LEFT_BRACKET}, {KEY_V, KEY_LEFT_BRACKET}, {KEY_2, KEY_LEFT_BRACKET}, {KEY_EQUAL, KEY_LEFT_BRACKET}, {KEY_MINUS, KEY_LEFT_BRACKET}, {0},    // B
+    {0}, {KEY_LEFT_SHIFT, KEY_3}, {KEY_LEFT_SHIFT, KEY_E}, {KEY_LEFT_SHIFT, KEY_4}, {KEY_LEFT_SHIFT, KEY_5}, {KEY_LEFT_SHIFT, KEY_6}, {0},    // X
+    {0}, {0}, {0}, {0}, {0}, {0}, {0},    // XK
+    {0}, {0}, {0}, {KEY_LEFT_SHIFT, KEY_Z}, {0}, {0}, {0},    // XT
+    {0}, {KEY_LEFT_SHIFT, KEY_7}, {0}, {KEY_LEFT_SHIFT, KEY_8}, {0}, {KEY_LEFT_SHIFT, KEY_9}, {0},    // XY
+    {0}, {0}, {0}, {0}, {0}, {0}, {0},    // XW
+    {0}, {0}, {0}, {0}, {0}, {0}, {0},    // WY
+    {0}, {0}, {0}, {KEY_4, KEY_LEFT_BRACKET}, {0}, {0}, {0},    // V
+    {0}, {KEY_LEFT_SHIFT, KEY_3}, {KEY_LEFT_SHIFT, KEY_E}, {KEY_LEFT_SHIFT, KEY_4}, {KEY_LEFT_SHIFT, KEY_5}, {KEY_LEFT_SHIFT, KEY_6}, {0},    // L
+};
+
+// ROMA_NN - ROMA_RAB
+static const uint8_t jisCommonSet[][2] =
+{
+    {KEY_Y},
+    {KEY_INTERNATIONAL3},
+    {KEY_LEFT_BRACKET},
+    {KEY_RIGHT_BRACKET},
+    {0},
+    {KEY_LEFT_SHIFT, KEY_COMMA},
+    {KEY_LEFT_SHIFT, KEY_PERIOD},
+    {0},
+    {0},
+};
+
+// ROMA_LCB - ROMA_NAMI, which are common to all the IMEs in the kana input mode
+static const uint8_t jisSymbolSet[][2] =
+{
+    {KEY_LEFT_SHIFT, KEY_RIGHT_BRACKET},
+    {KEY_LEFT_SHIFT, KEY_NON_US_HASH},
+    {0},
+    {0},
+    {0},
+    {0},
+    {KEY_LEFT_SHIFT, KEY_SLASH},
+    {0},
+    {0},
+    {0},
+    {0},
+    {0},
+};
+
 static const uint8_t dakuonFrom[] = { KEY_K, KEY_S, KEY_T, KEY_H };
 static const uint8_t dakuonTo[] = { KEY_G, KEY_Z, KEY_D, KEY_B };
 
 static const uint8_t kogakiFrom[] = { KEY_A, KEY_I, KEY_U, KEY_E, KEY_O };
 // static const uint8_t kogaki_to[] = { KEY_X, KEY_X, KEY_X, KEY_X, KEY_X };
 
-static void ProcessRomaji(uint8_t roma, uint8_t a[3]) {
+static void ConvertRomaji(uint8_t roma, uint8_t a[3], uint8_t ime, uint8_t layout) {
     const uint8_t* c;
     uint8_t i;
 
@@ -393,7 +457,7 @@ static void ProcessRomaji(uint8_t roma, uint8_t a[3]) {
     }
     if (ROMA_LCB <= roma && roma <= ROMA_NAMI) {
         i = roma - ROMA_LCB;
-        switch (PROFILE_Read(EEPROM_IME)) {
+        switch (ime) {
         case IME_GOOGLE:
             c = googleSet[i];
             break;
@@ -408,7 +472,6 @@ static void ProcessRomaji(uint8_t roma, uint8_t a[3]) {
             c = msSet[i];
             break;
         }
-        uint8_t layout = PROFILE_Read(EEPROM_BASE);
         for (i = 0; i < 3; ++i) {
             uint8_t key = c[i];
             if (KEYBOARD_IsJapanese(layout)) {
@@ -426,20 +489,587 @@ static void ProcessRomaji(uint8_t roma, uint8_t a[3]) {
     memset(a, 0, 3);
 }
 
+// The romaji of every kana code for the current IME and base layout, so that
+// a kana is converted with a single lookup.
+typedef struct {
+    uint8_t codes[ROMA_NAMI + 1][3];
+    uint8_t ime;
+    uint8_t layout;
+    bool valid;
+} ROMAJI_TABLE;
+
+static ROMAJI_TABLE romajiTable;
+
+static void UpdateRomajiTable(void)
+{
+    uint8_t ime = PROFILE_Read(EEPROM_IME);
+    uint8_t layout = PROFILE_Read(EEPROM_BASE);
+
+    if (romajiTable.valid && romajiTable.ime == ime && romajiTable.layout == layout) {
+        return;
+    }
+    for (int roma = 0; roma <= ROMA_NAMI; ++roma) {
+        ConvertRomaji(roma, romajiTable.codes[roma], ime, layout);
+    }
+    romajiTable.ime = ime;
+    romajiTable.layout = layout;
+    romajiTable.valid = true;
+}
+
+static void ProcessRomaji(uint8_t roma, uint8_t a[3]) {
+    if (roma <= ROMA_NAMI) {
+        memcpy(a, romajiTable.codes[roma], 3);
+    } else {
+        memset(a, 0, 3);
+    }
+}
+
+// Gets the JIS kana keys for the kana. Returns false if the kana has no key in
+// the kana input mode.
+static bool ProcessJISKana(uint8_t roma, uint8_t a[2]) {
+    const uint8_t* c = NULL;
+
+    if (roma < ROMA_ANN) {
+        c = jisKanaSet[roma];
+    } else if (ROMA_NN <= roma && roma <= ROMA_RAB) {
+        c = jisCommonSet[roma - ROMA_NN];
+    } else if ((KANA_DAKUTEN <= roma && roma <= KANA_CHOUON) || roma == ROMA_SPACE) {
+        // The Stickney codes are the JIS kana keys themselves.
+        c = commonSet[roma - ROMA_NN];
+    } else if (ROMA_LCB <= roma && roma <= ROMA_NAMI) {
+        c = jisSymbolSet[roma - ROMA_LCB];
+    }
+    if (!c || !c[0]) {
+        return false;
+    }
+    memcpy(a, c, 2);
+    return true;
+}
+
+// The IME cannot compose the M-type consonants and vowels in the kana input
+// mode, so they are composed into kana before typing the JIS kana keys.
+
+// ROMA_ANN - ROMA_OU: the vowel and the kana that follows it
+static const uint8_t mtypeEndings[][2] =
+{
+    {ROMA_A, ROMA_NN}, {ROMA_A, ROMA_KU}, {ROMA_A, ROMA_TU}, {ROMA_A, ROMA_I},
+    {ROMA_I, ROMA_NN}, {ROMA_I, ROMA_KU}, {ROMA_I, ROMA_TU},
+    {ROMA_U, ROMA_NN}, {ROMA_U, ROMA_KU}, {ROMA_U, ROMA_TU},
+    {ROMA_E, ROMA_NN}, {ROMA_E, ROMA_KI}, {ROMA_E, ROMA_TU}, {ROMA_E, ROMA_I},
+    {ROMA_O, ROMA_NN}, {ROMA_O, ROMA_KU}, {ROMA_O, ROMA_TU}, {ROMA_O, ROMA_U},
+};
+
+// ROMA_C - ROMA_Q: the kana for each vowel that follows the consonant
+static const uint8_t mtypeConsonants[][5][2] =
+{
+    {{ROMA_KA}, {ROMA_SI}, {ROMA_KU}, {ROMA_SE}, {ROMA_KO}},    // C
+    {{ROMA_HU, ROMA_XA}, {ROMA_HU, ROMA_XI}, {ROMA_HU}, {ROMA_HU, ROMA_XE}, {ROMA_HU, ROMA_XO}},    // F
+    {{ROMA_ZI, ROMA_XYA}, {ROMA_ZI}, {ROMA_ZI, ROMA_XYU}, {ROMA_ZI, ROMA_XE}, {ROMA_ZI, ROMA_XYO}},    // J
+    {{ROMA_KU, ROMA_XA}, {ROMA_KU, ROMA_XI}, {ROMA_KU}, {ROMA_KU, ROMA_XE}, {ROMA_KU, ROMA_XO}},    // Q
+};
+
+// The small kana after the I column kana for KY, SY, TY, etc.
+static const uint8_t mtypeSmallKana[5] = { ROMA_XYA, ROMA_XI, ROMA_XYU, ROMA_XE, ROMA_XYO };
+
+static uint8_t mtypeConsonant;  // the M-type consonant waiting for a vowel
+
+static bool IsConsonant(uint8_t roma)
+{
+    if (roma < ROMA_ANN) {
+        return roma && (roma % 7 == 0 || roma % 7 == 6);
+    }
+    return ROMA_C <= roma && roma <= ROMA_Q;
+}
+
+// Composes the consonant, if any, and the vowel into up to two kana.
+static void ComposeKana(uint8_t consonant, uint8_t vowel, uint8_t kana[2])
+{
+    kana[0] = vowel;
+    kana[1] = 0;
+    if (!consonant) {
+        return;
+    }
+    if (ROMA_C <= consonant) {
+        memcpy(kana, mtypeConsonants[consonant - ROMA_C][vowel - ROMA_A], 2);
+    } else if (consonant == ROMA_V) {
+        kana[0] = ROMA_VU;
+        if (vowel != ROMA_U) {
+            kana[1] = ROMA_X + vowel;
+        }
+    } else if (consonant % 7 == 6) {
+        kana[0] = consonant - 6 + ROMA_I;
+        kana[1] = mtypeSmallKana[vowel - ROMA_A];
+    } else {
+        kana[0] = consonant + vowel;
+    }
+}
+
+// Types the kana with the JIS kana keys. A kana without a JIS kana key is
+// dropped, as romaji would be typed as kana in the kana input mode. Returns
+// false if nothing is typed.
+static bool PutJISKana(uint8_t roma)
+{
+    uint8_t kana[4] = {0};
+    uint8_t codes[2];
+    bool typed = false;
+
+    if ((ROMA_A <= roma && roma <= ROMA_O) || (ROMA_ANN <= roma && roma <= ROMA_OU)) {
+        uint8_t vowel = roma;
+        if (ROMA_ANN <= roma) {
+            vowel = mtypeEndings[roma - ROMA_ANN][0];
+            kana[2] = mtypeEndings[roma - ROMA_ANN][1];
+        }
+        ComposeKana(mtypeConsonant, vowel, kana);
+        mtypeConsonant = 0;
+    } else if (IsConsonant(roma)) {
+        if (mtypeConsonant == ROMA_N) {
+            kana[0] = ROMA_NN;
+            roma = (roma == ROMA_N) ? 0 : roma;
+        } else if (mtypeConsonant == roma) {
+            kana[0] = ROMA_XTU;     // e.g., kk for っk
+        }
+        mtypeConsonant = roma;
+    } else {
+        if (mtypeConsonant == ROMA_N) {
+            kana[0] = ROMA_NN;
+        }
+        mtypeConsonant = 0;
+        kana[1] = roma;
+    }
+    for (int i = 0; i < 4; ++i) {
+        if (kana[i] && ProcessJISKana(kana[i], codes)) {
+            MACRO_Put(codes[0]);
+            MACRO_Put(codes[1]);
+            typed = true;
+        }
+    }
+    return typed;
+}
+
+//
+// Kana layouts
+//
+
+// In a layout with a postfix dakuten key, a kana that can take a dakuten is
+// held for a while so that its voiced form is typed at once.
+#define KANA_LAYOUT_POSTFIX_DAKUTEN 0x01
+// The left and right planes are typed with the NICOLA thumb keys.
+#define KANA_LAYOUT_THUMB_CHORD     0x02
+// The codes are typed as the JIS kana keys in either kana output mode.
+#define KANA_LAYOUT_JIS_KEYS        0x04
+#define KANA_LAYOUT_FLAGS           (KANA_LAYOUT_POSTFIX_DAKUTEN | KANA_LAYOUT_THUMB_CHORD | KANA_LAYOUT_JIS_KEYS)
+
+typedef struct {
+    const uint8_t (*normal)[MATRIX_COLS];
+    const uint8_t (*left)[MATRIX_COLS];
+    const uint8_t (*right)[MATRIX_COLS];
+    uint8_t flags;
+} KANA_LAYOUT;
+
+static const KANA_LAYOUT kanaLayouts[KANA_USER] = {
+    // KANA_ROMAJI
+    {NULL, NULL, NULL, 0},
+    // KANA_NICOLA
+    {matrixNicola, matrixNicolaLeft, matrixNicolaRight, KANA_LAYOUT_THUMB_CHORD},
+    // KANA_TRON
+    {matrixTron, matrixTronLeft, matrixTronRight, 0},
+    // KANA_STICKNEY types the dakuten key of the JIS kana layout
+    {matrixStickney, matrixStickneyShift, matrixStickneyShift, KANA_LAYOUT_JIS_KEYS},
+    // KANA_X6004
+    {matrixX6004, matrixX6004Shift, matrixX6004Shift, KANA_LAYOUT_POSTFIX_DAKUTEN},
+    // KANA_MTYPE has no dakuten key
+    {matrixMtype, matrixMtypeShift, matrixMtypeShift, 0},
+    // KANA_NEW_STICKNEY
+    {matrixNewStickney, matrixNewStickneyShift, matrixNewStickneyShift, KANA_LAYOUT_POSTFIX_DAKUTEN},
+};
+
+// A user kana layout is written by a UF2 file to KANA_LAYOUT_ADDRESS, out of
+// the firmware image, and copied into RAM at start up.
+#define KANA_LAYOUT_SIZE        512
+#define KANA_LAYOUT_ADDRESS     (RECORDER_ADDRESS - KANA_LAYOUT_SIZE)
+#define KANA_LAYOUT_MAGIC       0x4c4b  // "KL"
+#define KANA_LAYOUT_VERSION     1
+
+typedef struct {
+    uint16_t magic;
+    uint8_t version;
+    uint8_t flags;
+    uint8_t planes[3][MATRIX_ROWS][MATRIX_COLS];    // normal, left and right
+    uint16_t checksum;                              // sum of the plane bytes
+} KANA_LAYOUT_IMAGE;
+
+static KANA_LAYOUT_IMAGE __attribute__((aligned(4))) userImage;
+static KANA_LAYOUT userLayout;
+
+static const KANA_LAYOUT* GetKanaLayout(uint8_t kana)
+{
+    if (kana == KANA_USER && userLayout.normal) {
+        return &userLayout;
+    }
+    if (KANA_USER <= kana) {
+        return &kanaLayouts[KANA_ROMAJI];
+    }
+    return &kanaLayouts[kana];
+}
+
+static bool IsValidKanaLayout(const KANA_LAYOUT_IMAGE* image)
+{
+    const uint8_t* codes = &image->planes[0][0][0];
+    uint16_t sum = 0;
+
+    if (image->magic != KANA_LAYOUT_MAGIC || image->version != KANA_LAYOUT_VERSION) {
+        return false;
+    }
+    if (image->flags & ~KANA_LAYOUT_FLAGS) {
+        return false;
+    }
+    for (size_t i = 0; i < sizeof image->planes; ++i) {
+        if (ROMA_NAMI < codes[i]) {
+            return false;
+        }
+        sum += codes[i];
+    }
+    return sum == image->checksum;
+}
+
+void KEYBOARD_LoadKanaLayout(void)
+{
+    memset(&userLayout, 0, sizeof userLayout);
+    while (NVMCTRL_IsBusy())
+        ;
+    NVMCTRL_ErrorGet();
+    NVMCTRL_Read((void*) &userImage, sizeof userImage, KANA_LAYOUT_ADDRESS);
+    if (!IsValidKanaLayout(&userImage)) {
+        return;
+    }
+    userLayout.normal = userImage.planes[0];
+    userLayout.left = userImage.planes[1];
+    userLayout.right = userImage.planes[2];
+    userLayout.flags = userImage.flags;
+}
+
+bool KEYBOARD_HasUserKanaLayout(void)
+{
+    return userLayout.normal != NULL;
+}
+
+bool KEYBOARD_HasKanaLayout(void)
+{
+    return GetKanaLayout(PROFILE_Read(EEPROM_KANA))->normal != NULL;
+}
+
 static uint8_t last[3];
+static uint8_t pending;         // the kana held for a dakuten
+static uint32_t pendingUntil;   // APP_GetMicroseconds() to type the pending kana
+
+// Gets the romaji of the kana in codes followed by the dakuten or handakuten
+// mark. Returns false if the kana cannot take the mark.
+static bool GetVoiced(const uint8_t codes[3], uint8_t mark, uint8_t voiced[3])
+{
+    const uint8_t* dakuon;
+
+    memset(voiced, 0, 3);
+    if (!codes[0]) {
+        return false;
+    }
+    if (mark == KEY_DAKUTEN) {
+        if ((dakuon = memchr(dakuonFrom, codes[0], sizeof dakuonFrom))) {
+            voiced[0] = dakuonTo[dakuon - dakuonFrom];
+            voiced[1] = codes[1];
+            return true;
+        }
+        if (memchr(kogakiFrom, codes[0], sizeof kogakiFrom)) {
+            voiced[0] = KEY_X;
+            voiced[1] = codes[0];
+            return true;
+        }
+        if (codes[0] == KEY_Y && memchr(kogakiFrom, codes[1], sizeof kogakiFrom)) {
+            voiced[0] = KEY_X;
+            voiced[1] = KEY_Y;
+            voiced[2] = codes[1];
+            return true;
+        }
+    } else if (mark == KEY_HANDAKU && codes[0] == KEY_H) {
+        voiced[0] = KEY_P;
+        voiced[1] = codes[1];
+        return true;
+    }
+    return false;
+}
+
+static void PutCodes(const uint8_t codes[3])
+{
+    for (int i = 0; i < 3 && codes[i]; ++i) {
+        MACRO_Put(codes[i]);
+    }
+}
+
+static void PutPending(void)
+{
+    ProcessRomaji(pending, last);
+    PutCodes(last);
+    pending = 0;
+}
+
+// Returns the time to hold a kana for a dakuten in msec, or zero. The held kana
+// is typed at the first matrix scan after the time, i.e., within about 12 msec.
+static uint16_t GetLookahead(void)
+{
+    if (!(GetKanaLayout(PROFILE_Read(EEPROM_KANA))->flags & KANA_LAYOUT_POSTFIX_DAKUTEN)) {
+        return 0;
+    }
+    return 100u * PROFILE_Read(EEPROM_LOOKAHEAD);
+}
+
+// Types the kana codes through the macro queue.
+static int8_t PutKana(const uint8_t* kana, int count)
+{
+    int8_t xmit = XMIT_NONE;
+    uint8_t keycode;
+
+    UpdateRomajiTable();
+
+    bool jis = PROFILE_Read(EEPROM_KANA_OUTPUT) == KANA_OUTPUT_JIS &&
+               !(GetKanaLayout(PROFILE_Read(EEPROM_KANA))->flags & KANA_LAYOUT_JIS_KEYS);
+    // The IME composes the dakuten by itself in the kana input mode.
+    uint16_t lookahead = jis ? 0 : GetLookahead();
+
+    // Convert Kana into Romaji
+    for (int i = 0; i < count; ++i) {
+        uint8_t codes[3];
+
+        if (pending) {
+            xmit = XMIT_MACRO;
+            ProcessRomaji(kana[i], codes);
+            uint8_t voiced[3];
+            uint8_t held[3];
+            ProcessRomaji(pending, held);
+            if (GetVoiced(held, codes[0], voiced)) {
+                // Type the voiced form in place of the held kana
+                pending = 0;
+                PutCodes(voiced);
+                memcpy(last, held, 3);
+                continue;
+            }
+            PutPending();
+        }
+        if (jis) {
+            if (PutJISKana(kana[i])) {
+                xmit = XMIT_MACRO;
+            }
+            memset(last, 0, sizeof last);
+            continue;
+        }
+        ProcessRomaji(kana[i], codes);
+        // Hold only the kana that have a voiced form. The small kana made from
+        // a vowel or ya, yu, and yo with a dakuten are left to the backspace
+        // below so that they are not delayed.
+        if (lookahead && kana[i] < ROMA_ANN) {
+            if (codes[0] && memchr(dakuonFrom, codes[0], sizeof dakuonFrom)) {
+                pending = kana[i];
+                pendingUntil = APP_GetMicroseconds() + 1000u * lookahead;
+                continue;
+            }
+        }
+        for (int j = 0; j < 3 && codes[j]; ++j) {
+            keycode = codes[j];
+            switch (keycode) {
+            case KEY_DAKUTEN:
+            case KEY_HANDAKU: {
+                uint8_t voiced[3];
+                if (GetVoiced(last, keycode, voiced)) {
+                    xmit = XMIT_MACRO;
+                    MACRO_Put(KEY_BACKSPACE);
+                    PutCodes(voiced);
+                }
+                break;
+            }
+            default:
+                xmit = XMIT_MACRO;
+                MACRO_Put(keycode);
+                break;
+            }
+        }
+        if (codes[0]) {
+            memcpy(last, codes, 3);
+        }
+    }
+    return xmit;
+}
+
+//
+// NICOLA chords (JIS X 4063)
+//
+// A character key and a thumb key pressed within the chord window in either
+// order make a chord. A character key is held until it is paired with a thumb
+// key, or until it is released, another character key is pressed, or the
+// window passes. When a character key, a thumb key and another character key
+// are pressed in this order, the thumb key goes with the closer one.
+//
+// A thumb key held before a character key shifts every character key pressed
+// while it is held (continuous shift). A thumb key pressed after the character
+// key it goes with does not shift the next character keys until it is
+// released.
+
+#define CHORD_IDLE          0
+#define CHORD_CHAR          1   // a character key is held
+#define CHORD_CHAR_THUMB    2   // a character key is held with a later thumb key
+
+// The window is checked at every matrix scan, i.e., about every 12 msec, so a
+// character key without a thumb key is typed within a scan after the window.
+static const uint8_t chordWindows[CHORD_MAX + 1] = {
+    0, 50, 75, 100  // msec
+};
+
+typedef struct {
+    const KANA_LAYOUT* layout;
+    uint8_t state;
+    uint8_t stroke;         // the held character key (row * MATRIX_COLS + col)
+    uint8_t thumb;          // the thumb key paired with the held character key
+    uint8_t mod;            // the thumb keys pressed
+    uint8_t used;           // the thumb keys paired with an earlier character key pressed before them
+    uint32_t window;        // [usec]
+    uint32_t charTime;
+    uint32_t thumbTime;
+} NICOLA_CHORD;
+
+static NICOLA_CHORD chord;
+
+static uint32_t GetChordWindow(void)
+{
+    uint8_t window = PROFILE_Read(EEPROM_CHORD);
+
+    if (CHORD_MAX < window) {
+        return 0;
+    }
+    return 1000u * chordWindows[window];
+}
+
+static uint8_t GetChordKana(uint8_t stroke, uint8_t thumb)
+{
+    uint8_t row = stroke / MATRIX_COLS;
+    uint8_t col = stroke % MATRIX_COLS;
+
+    if (thumb & MOD_SHIFT_LEFT) {
+        return chord.layout->left[row][col];
+    }
+    if (thumb & MOD_SHIFT_RIGHT) {
+        return chord.layout->right[row][col];
+    }
+    return chord.layout->normal[row][col];
+}
+
+static void HoldChord(uint8_t stroke, uint32_t now)
+{
+    chord.state = CHORD_CHAR;
+    chord.stroke = stroke;
+    chord.charTime = now;
+}
+
+// Pairs the held character key with the thumb key and returns its kana.
+static uint8_t TakeChord(bool shifted)
+{
+    chord.state = CHORD_IDLE;
+    if (!shifted) {
+        return GetChordKana(chord.stroke, 0);
+    }
+    chord.used |= chord.thumb;
+    return GetChordKana(chord.stroke, chord.thumb);
+}
+
+// Processes the thumb keys, the release of the held keys, and the chord
+// window. Returns the number of kana added to kana.
+static int UpdateChord(uint8_t mod, uint32_t now, uint8_t* kana)
+{
+    uint8_t thumbs = mod & MOD_SHIFT;
+    uint8_t made = thumbs & ~chord.mod;
+    bool pressed;
+
+    chord.mod = thumbs;
+    chord.used &= thumbs;
+    switch (chord.state) {
+    case CHORD_CHAR:
+        pressed = KEYBOARD_IsPressed(chord.stroke / MATRIX_COLS, chord.stroke % MATRIX_COLS);
+        if (!pressed || chord.window < now - chord.charTime) {
+            kana[0] = TakeChord(false);
+            return 1;
+        }
+        if (made) {
+            chord.state = CHORD_CHAR_THUMB;
+            chord.thumb = (made & MOD_SHIFT_LEFT) ? MOD_SHIFT_LEFT : MOD_SHIFT_RIGHT;
+            chord.thumbTime = now;
+        }
+        break;
+    case CHORD_CHAR_THUMB:
+        pressed = KEYBOARD_IsPressed(chord.stroke / MATRIX_COLS, chord.stroke % MATRIX_COLS);
+        if (!pressed && (thumbs & chord.thumb)) {
+            // The thumb key overlapping less than half of the character key
+            // was pressed for the next character.
+            kana[0] = TakeChord(now - chord.charTime <= 2 * (now - chord.thumbTime));
+            return 1;
+        }
+        if (!pressed || !(thumbs & chord.thumb) || chord.window < now - chord.thumbTime) {
+            kana[0] = TakeChord(true);
+            return 1;
+        }
+        break;
+    default:
+        break;
+    }
+    return 0;
+}
+
+// Processes a character key pressed. Returns the number of kana added to kana.
+static int StrokeChord(uint8_t stroke, uint32_t now, uint8_t* kana)
+{
+    uint8_t thumbs = chord.mod & ~chord.used;
+    int count = 0;
+
+    switch (chord.state) {
+    case CHORD_CHAR:
+        kana[count++] = TakeChord(false);
+        break;
+    case CHORD_CHAR_THUMB:
+        if (chord.thumbTime - chord.charTime <= now - chord.thumbTime) {
+            kana[count++] = TakeChord(true);
+        } else {
+            // The thumb key goes with the new character key as if it had
+            // been pressed first, so it keeps shifting while it is held.
+            kana[count++] = TakeChord(false);
+            kana[count++] = GetChordKana(stroke, chord.thumb);
+            return count;
+        }
+        thumbs = chord.mod & ~chord.used;
+        break;
+    default:
+        break;
+    }
+    if (thumbs) {
+        // The thumb key pressed first shifts the character key at once.
+        kana[count++] = GetChordKana(stroke, thumbs);
+    } else {
+        HoldChord(stroke, now);
+    }
+    return count;
+}
+
+#define MAX_STROKES     6
 
 static int8_t ProcessKana(uint8_t *buf, size_t bufLen,
-                          const uint8_t mod,
-                          const uint8_t normal[MATRIX_ROWS][MATRIX_COLS],
-                          const uint8_t left[MATRIX_ROWS][MATRIX_COLS],
-                          const uint8_t right[MATRIX_ROWS][MATRIX_COLS])
+                          const uint8_t mod, const KANA_LAYOUT* layout)
 {
+    const uint8_t (*normal)[MATRIX_COLS] = layout->normal;
+    const uint8_t (*left)[MATRIX_COLS] = layout->left;
+    const uint8_t (*right)[MATRIX_COLS] = layout->right;
     uint8_t roma;
     int8_t xmit = XMIT_NONE;
-    uint8_t kana[6];
+    uint8_t kana[MAX_STROKES * 2 + MAX_STROKES + 1];
     int currentKana = 0;
     int currentAscii = 2;
     uint8_t keycode;
+    uint8_t strokes[MAX_STROKES];
+    int currentStroke = 0;
+    uint32_t window = (layout->flags & KANA_LAYOUT_THUMB_CHORD) ? GetChordWindow() : 0;
 
     // Scan the keyboard matrix to check if any Kana key is pressed.
     memset(buf, 0, bufLen);
@@ -456,6 +1086,12 @@ static int8_t ProcessKana(uint8_t *buf, size_t bufLen,
                 }
                 continue;
             }
+            if (window && normal[row][col]) {
+                if (KEYBOARD_IsMake(row, col) && currentStroke < MAX_STROKES) {
+                    strokes[currentStroke++] = row * MATRIX_COLS + col;
+                }
+                continue;
+            }
             roma = 0;
             if (mod & MOD_SHIFT_LEFT)
                 roma = left[row][col];
@@ -464,7 +1100,7 @@ static int8_t ProcessKana(uint8_t *buf, size_t bufLen,
             else
                 roma = normal[row][col];
             if (roma) {
-                if (KEYBOARD_IsMake(row, col) && currentKana < sizeof kana) {
+                if (KEYBOARD_IsMake(row, col) && currentKana < MAX_STROKES) {
                     kana[currentKana++] = roma;
                 }
             } else {
@@ -481,6 +1117,16 @@ static int8_t ProcessKana(uint8_t *buf, size_t bufLen,
         }
     }
 
+    if (window || chord.state != CHORD_IDLE) {
+        uint32_t now = APP_GetMicroseconds();
+        currentKana += UpdateChord(mod, now, kana + currentKana);
+        chord.layout = layout;
+        chord.window = window;
+        for (int i = 0; i < currentStroke; ++i) {
+            currentKana += StrokeChord(strokes[i], now, kana + currentKana);
+        }
+    }
+
     // If no Kana keys were pressed, return the normal keyboard state.
     if (currentKana == 0) {
         if (2 < currentAscii) {
@@ -493,6 +1139,10 @@ static int8_t ProcessKana(uint8_t *buf, size_t bufLen,
         return XMIT_NONE;
     }
 
+    if (pending && 2 < currentAscii) {
+        xmit = XMIT_MACRO;
+        PutPending();
+    }
     for (int i = 2; i < currentAscii; ++i) {
         keycode = buf[i];
         if (!KEYBOARD_IsModifier(keycode)) {
@@ -503,73 +1153,56 @@ static int8_t ProcessKana(uint8_t *buf, size_t bufLen,
         }
     }
 
-    // Convert Kana into Romaji
-    for (int i = 0; i < currentKana; ++i) {
-        uint8_t codes[3];
+    if (PutKana(kana, currentKana) == XMIT_MACRO) {
+        xmit = XMIT_MACRO;
+    }
+    return xmit;
+}
 
-        ProcessRomaji(kana[i], codes);
-        for (int j = 0; j < 3 && codes[j]; ++j) {
-            keycode = codes[j];
-            switch (keycode) {
-            case KEY_DAKUTEN:
-                if (last[0]) {
-                    const uint8_t* dakuon;
-                    if ((dakuon = memchr(dakuonFrom, last[0], sizeof dakuonFrom))) {
-                        xmit = XMIT_MACRO;
-                        MACRO_Put(KEY_BACKSPACE);
-                        MACRO_Put(dakuonTo[dakuon - dakuonFrom]);
-                        MACRO_Put(last[1]);
-                    } else if ((dakuon = memchr(kogakiFrom, last[0], sizeof kogakiFrom))) {
-                        xmit = XMIT_MACRO;
-                        MACRO_Put(KEY_BACKSPACE);
-                        MACRO_Put(KEY_X);
-                        MACRO_Put(last[0]);
-                    } else if (last[0] == KEY_Y && (dakuon = memchr(kogakiFrom, last[1], sizeof kogakiFrom))) {
-                        xmit = XMIT_MACRO;
-                        MACRO_Put(KEY_BACKSPACE);
-                        MACRO_Put(KEY_X);
-                        MACRO_Put(KEY_Y);
-                        MACRO_Put(last[1]);
-                    }
-                }
-                break;
-            case KEY_HANDAKU:
-                if (last[0] == KEY_H) {
-                    xmit = XMIT_MACRO;
-                    MACRO_Put(KEY_BACKSPACE);
-                    MACRO_Put(KEY_P);
-                    MACRO_Put(last[1]);
-                }
-                break;
-            default:
-                xmit = XMIT_MACRO;
-                MACRO_Put(keycode);
-                break;
-            }
+bool KEYBOARD_FlushKana(bool force)
+{
+    bool flushed = false;
+
+    if (chord.state != CHORD_IDLE) {
+        uint8_t kana[1];
+        int count = 1;
+
+        if (force) {
+            kana[0] = TakeChord(chord.state == CHORD_CHAR_THUMB);
+        } else {
+            count = UpdateChord(chord.mod, APP_GetMicroseconds(), kana);
         }
-        if (codes[0]) {
-            memcpy(last, codes, 3);
+        if (count) {
+            PutKana(kana, count);
+            flushed = true;
         }
     }
-    return xmit;
+    if (pending && (force || 0 <= (int32_t) (APP_GetMicroseconds() - pendingUntil))) {
+        PutPending();
+        flushed = true;
+    }
+    if (flushed && force) {
+        // Another key follows the kana.
+        memset(last, 0, sizeof last);
+    }
+    return flushed;
+}
+
+// Discards the kana held for a dakuten or a chord, and the M-type consonant.
+void KEYBOARD_ResetKana(void)
+{
+    memset(&chord, 0, sizeof chord);
+    pending = 0;
+    mtypeConsonant = 0;
+    memset(last, 0, sizeof last);
 }
 
 int8_t KEYBOARD_GetKanaReport(uint8_t *buf, size_t bufLen, const uint8_t mod)
 {
-    switch (PROFILE_Read(EEPROM_KANA)) {
-    case KANA_NICOLA:
-        return ProcessKana(buf, bufLen, mod, matrixNicola, matrixNicolaLeft, matrixNicolaRight);
-    case KANA_TRON:
-        return ProcessKana(buf, bufLen, mod, matrixTron, matrixTronLeft, matrixTronRight);
-    case KANA_STICKNEY:
-        return ProcessKana(buf, bufLen, mod, matrixStickney, matrixStickneyShift, matrixStickneyShift);
-    case KANA_X6004:
-        return ProcessKana(buf, bufLen, mod, matrixX6004, matrixX6004Shift, matrixX6004Shift);
-    case KANA_MTYPE:
-        return ProcessKana(buf, bufLen, mod, matrixMtype, matrixMtypeShift, matrixMtypeShift);
-    case KANA_NEW_STICKNEY:
-        return ProcessKana(buf, bufLen, mod, matrixNewStickney, matrixNewStickneyShift, matrixNewStickneyShift);
-    default:
+    const KANA_LAYOUT* layout = GetKanaLayout(PROFILE_Read(EEPROM_KANA));
+
+    if (!layout->normal) {
         return XMIT_NONE;
     }
+    return ProcessKana(buf, bufLen, mod, layout);
 }
@@ -550,8 +550,13 @@ bool KEYBOARD_IsMake(int row, int col);
 
 bool KEYBOARD_GetReport(uint8_t* preport);
 int8_t KEYBOARD_GetFnReport(uint8_t keycode);
-bool KEYBOARD_GetMacroReport(uint8_t* preport);
+int8_t KEYBOARD_GetFnShiftReport(uint8_t keycode);
 int8_t KEYBOARD_GetKanaReport(uint8_t *buf, size_t bufLen, const uint8_t mod);
+bool KEYBOARD_FlushKana(bool force);
+void KEYBOARD_ResetKana(void);
+void KEYBOARD_LoadKanaLayout(void);
+bool KEYBOARD_HasUserKanaLayout(void);
+bool KEYBOARD_HasKanaLayout(void);
 
 bool KEYBOARD_GetConsumerReport(uint8_t* preport);
 
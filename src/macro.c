@@ -16,48 +16,84 @@
 
 #include "app.h"
 
+// The macro steps are kept in a ring buffer so that new steps can be queued
+// behind the steps still being played.
 typedef struct {
-    uint8_t keys[MAX_MACRO_SIZE];
-    size_t pos;
-    size_t max;
+    MACRO_STEP steps[MAX_MACRO_STEPS];
+    size_t head;        // next step to play
+    size_t tail;        // next free slot
+    uint8_t modifiers;  // modifiers for the next key put by MACRO_Put()
 } MACRO_DATA;
 
 static MACRO_DATA macroData;
 
-void MACRO_Begin(size_t max)
+static size_t Next(size_t pos)
 {
-    macroData.pos = 0;
-    macroData.max = max;
+    return (pos + 1) % MAX_MACRO_STEPS;
 }
 
-uint8_t MACRO_Peek(void)
+// Returns false if the queue is full.
+static bool PutStep(MACRO_STEP step)
 {
-    if (macroData.pos < macroData.max) {
-        return macroData.keys[macroData.pos];
+    if (Next(macroData.tail) == macroData.head) {
+        return false;
     }
-    return 0;
+    macroData.steps[macroData.tail] = step;
+    macroData.tail = Next(macroData.tail);
+    return true;
 }
 
-uint8_t MACRO_Get(void)
+void MACRO_Clear(void)
 {
-    if (macroData.pos < macroData.max) {
-        uint8_t key = macroData.keys[macroData.pos++];
-        if (key) {
-            return key;
-        }
+    macroData.head = macroData.tail;
+    macroData.modifiers = 0;
+}
+
+bool MACRO_IsEmpty(void)
+{
+    return macroData.head == macroData.tail;
+}
+
+MACRO_STEP MACRO_Peek(void)
+{
+    if (MACRO_IsEmpty()) {
+        return 0;
     }
-    macroData.pos = macroData.max = 0;
-    return 0;
+    return macroData.steps[macroData.head];
 }
 
-void MACRO_Put(uint8_t c)
+MACRO_STEP MACRO_Get(void)
 {
-    if (macroData.pos < MAX_MACRO_SIZE) {
-        macroData.keys[macroData.pos++] = c;
-        if (macroData.pos < MAX_MACRO_SIZE) {
-            macroData.keys[macroData.pos] = 0;
-        }
+    if (MACRO_IsEmpty()) {
+        return 0;
+    }
+    MACRO_STEP step = macroData.steps[macroData.head];
+    macroData.head = Next(macroData.head);
+    return step;
+}
+
+// A modifier key is folded into the step of the key that follows it.
+bool MACRO_Put(uint8_t c)
+{
+    if (KEYBOARD_IsModifier(c)) {
+        macroData.modifiers |= 1u << (c - KEY_LEFT_CONTROL);
+        return true;
+    }
+    if (c) {
+        return MACRO_PutStep(macroData.modifiers, c);
+    }
+    return true;
+}
+
+bool MACRO_PutStep(uint8_t modifiers, uint8_t key)
+{
+    bool queued = true;
+
+    if (key) {
+        queued = PutStep(MACRO_STEP_MAKE(modifiers, key));
     }
+    macroData.modifiers = 0;
+    return queued;
 }
 
 void MACRO_Puts(const uint8_t* s)
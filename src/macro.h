@@ -17,15 +17,27 @@
 #ifndef ESRILLE_MACRO_H
 #define ESRILLE_MACRO_H
 
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 
-#define MAX_MACRO_SIZE  1024
+#define MAX_MACRO_STEPS 1024
 
-void MACRO_Begin(size_t max);
-uint8_t MACRO_Peek(void);
-uint8_t MACRO_Get(void);
-void MACRO_Put(uint8_t c);
+// A macro step is a key with its modifier bits, which are pressed together in
+// a single report.
+typedef uint16_t MACRO_STEP;
+
+#define MACRO_STEP_MAKE(modifiers, key) ((MACRO_STEP) (((modifiers) << 8) | (key)))
+#define MACRO_STEP_KEY(step)            ((uint8_t) (step))
+#define MACRO_STEP_MODIFIERS(step)      ((uint8_t) ((step) >> 8))
+
+void MACRO_Clear(void);
+bool MACRO_IsEmpty(void);
+MACRO_STEP MACRO_Peek(void);
+MACRO_STEP MACRO_Get(void);
+// MACRO_Put() and MACRO_PutStep() return false if the queue is full.
+bool MACRO_Put(uint8_t c);
+bool MACRO_PutStep(uint8_t modifiers, uint8_t key);
 void MACRO_Puts(const uint8_t* s);
 void MACRO_PutNumber(uint16_t n);
 
@@ -41,6 +41,14 @@ int main(void)
         // Continuously poll all MPLAB Harmony state machines to ensure they are functioning correctly
         SYS_Tasks();
 
+#if APP_HAS_MOUSE_INTERFACE
+        // Decode the TSAP frames received by SERCOM4
+        if (!TSAP_IsIdle()) {
+            TSAP_Poll();
+            APP_ReportsUpdated();
+        }
+#endif
+
         // Check if the tick count has changed since the last iteration
         if (tick != APP_GetTick()) {
             // Update the tick count to the current value
@@ -49,11 +57,27 @@ int main(void)
             if (!APP_Suspended()) {
                 // If the application is not suspended, execute the keyboard task
                 KEYBOARD_Task();
+                APP_ReportsUpdated();
             } else if (KEYBOARD_ScanMatrix()) {
                 // If the application is suspended and any key is pressed, wake up the application
                 APP_WakeUp();
             }
         }
+
+        // Sleep until the next interrupt if there is nothing to do. The USB SOF
+        // interrupt wakes up the CPU every millisecond while the bus is active.
+        // An interrupt that becomes pending after the checks below still ends
+        // WFI at once, as the Cortex-M0+ wakes up on a pending interrupt even
+        // while PRIMASK is set; the handler then runs after the restore.
+        bool interruptStatus = NVIC_INT_Disable();
+        if (tick == APP_GetTick() && APP_IsIdle()
+#if APP_HAS_MOUSE_INTERFACE
+                && TSAP_IsIdle()
+#endif
+        ) {
+            PM_IdleModeEnter();
+        }
+        NVIC_INT_Restore(interruptStatus);
     }
 
     // Execution should not come here during normal operation
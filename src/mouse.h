@@ -20,7 +20,14 @@
 #include <stdbool.h>
 #include <stdint.h>
 
-#define MOUSE_REPORT_LEN        4
+#define MOUSE_REPORT_LEN        4       // 8-bit X/Y report for the BLE module
+#define MOUSE_USB_REPORT_LEN    7       // 16-bit X/Y report with AC Pan for USB
+
+#define MOUSE_WHEEL_MULTIPLIER  8       // Physical Maximum of the Resolution Multiplier
+
+// Resolution Multiplier feature report
+#define MOUSE_FEATURE_WHEEL     0x01
+#define MOUSE_FEATURE_PAN       0x04
 
 #define MOUSE_BUTTON_LEFT       0x01    // Left button
 #define MOUSE_BUTTON_RIGHT      0x02    // Right button
@@ -30,10 +37,13 @@
 
 typedef struct
 {
-    uint8_t data[MOUSE_REPORT_LEN];
+    uint8_t data[MOUSE_USB_REPORT_LEN];
 } MOUSE_REPORT;
 
 bool MOUSE_GetReport(uint8_t* preport);
+bool MOUSE_GetUSBReport(uint8_t* preport);
+uint8_t MOUSE_GetFeature(void);
+void MOUSE_SetFeature(uint8_t feature);
 void MOUSE_About(void);
 
 #endif  // ESRILLE_MOUSE_H
@@ -44,7 +44,11 @@ static const uint8_t initialProfileData[PROFILE_DATA_SIZE] = {
     INDICATOR_DEFAULT,
     IME_MS,
     PAD_SENSE_1,
-    PREFIXSHIFT_OFF
+    PREFIXSHIFT_OFF,
+    PACE_FAST,
+    KANA_OUTPUT_ROMAJI,
+    LOOKAHEAD_OFF,
+    CHORD_OFF
 };
 
 static const uint8_t marixNumLock[MATRIX_ROWS][MATRIX_COLS] = {
@@ -242,6 +246,10 @@ typedef struct {
     uint8_t leds;
     uint8_t report[KEYBOARD_REPORT_LEN];
     uint8_t reportPrev[KEYBOARD_REPORT_LEN];
+    uint8_t captured[KEYBOARD_REPORT_LEN];  // keys sampled during macro playback
+    uint8_t consumed[KEYBOARD_REPORT_LEN - 2];  // keys queued to the macro and still held
+    uint32_t holdUntil;     // APP_GetMicroseconds() to resume the macro playback
+    bool holding;
     bool enableLEDs;
 
     // cc
@@ -255,6 +263,7 @@ typedef struct {
 
     // profile
     uint8_t profile;
+    bool switching;
 } NISSE_CONTROL;
 
 static NISSE_CONTROL controller;
@@ -319,6 +328,15 @@ void KEYBOARD_UpdateLEDs(void)
         if (controller.kana && controller.prefix && PROFILE_Read(EEPROM_PREFIX) == PREFIXSHIFT_LED) {
             bits |= LED_SCROLL_LOCK_BIT;
         }
+        // Blink the Scroll Lock LED about every half a second while recording,
+        // whether or not Scroll Lock is on.
+        if (RECORDER_IsRecording()) {
+            if (APP_GetMicroseconds() & (1u << 19)) {
+                bits |= LED_SCROLL_LOCK_BIT;
+            } else {
+                bits &= ~LED_SCROLL_LOCK_BIT;
+            }
+        }
     }
     for (unsigned int i = 0; i < sizeof ledPins; ++i) {
         if (bits & (1u << i)) {
@@ -585,6 +603,28 @@ static uint16_t GetModifiers(void)
     return mod;
 }
 
+static void AddConsumedKey(uint8_t key)
+{
+    uint8_t* slot = memchr(controller.consumed, 0, sizeof controller.consumed);
+
+    if (slot) {
+        *slot = key;
+    }
+}
+
+// Queue the keys in the report behind the steps in the macro queue. A key
+// that does not fit in the queue is not consumed, so that it is reported as
+// it is after the macro.
+static void QueueReport(const uint8_t* buf)
+{
+    for (int i = 2; i < KEYBOARD_REPORT_LEN && buf[i]; ++i) {
+        if (!MACRO_PutStep(buf[0], buf[i])) {
+            break;
+        }
+        AddConsumedKey(buf[i]);
+    }
+}
+
 static int8_t GetReport(uint8_t *buf, size_t bufLen, uint16_t *cc) {
     size_t currentReportByte = 2;
     uint16_t mod = GetModifiers();
@@ -632,11 +672,13 @@ static int8_t GetReport(uint8_t *buf, size_t bufLen, uint16_t *cc) {
                                     controller.dualRoleFN = 0;
                                     return XMIT_NORMAL;
                                 }
+                            } else if (KEYBOARD_IsMake(i, j) && KEYBOARD_GetFnShiftReport(keycode)) {
+                                controller.dualRoleFN = 0;
+                                return XMIT_IN_ORDER;
                             }
                         } else if (ccMap[keycode - KEY_F1]) {
                             *cc = ccMap[keycode - KEY_F1];
                         } else if (KEYBOARD_IsMake(i, j) && KEYBOARD_GetFnReport(keycode)) {
-                            MACRO_Begin(MAX_MACRO_SIZE);
                             controller.dualRoleFN = 0;
                             return XMIT_IN_ORDER;
                         }
@@ -667,7 +709,7 @@ static int8_t GetReport(uint8_t *buf, size_t bufLen, uint16_t *cc) {
 
     if (!controller.kana ||
         (mod & (MOD_CONTROL | MOD_ALT | MOD_GUI | MOD_EXT_CAPS_LCOK)) ||
-        PROFILE_Read(EEPROM_KANA) == KANA_ROMAJI)
+        !KEYBOARD_HasKanaLayout())
     {
         // Normal layer
         for (int row = 0; row < MATRIX_ROWS; ++row) {
@@ -696,7 +738,6 @@ static int8_t GetReport(uint8_t *buf, size_t bufLen, uint16_t *cc) {
         switch (xmit) {
         case XMIT_MACRO:
             controller.prefix = 0;
-            MACRO_Begin(MAX_MACRO_SIZE);
             return XMIT_IN_ORDER;
         case XMIT_NORMAL:
             while (currentReportByte < bufLen && buf[currentReportByte]) {
@@ -727,6 +768,12 @@ static int8_t GetReport(uint8_t *buf, size_t bufLen, uint16_t *cc) {
     if (buf[2]) {
         // Reset prefix shift
         controller.prefix = 0;
+
+        // The kana held for a dakuten goes first.
+        if (KEYBOARD_FlushKana(true)) {
+            QueueReport(buf);
+            return XMIT_IN_ORDER;
+        }
     }
 
     return XMIT_NORMAL;
@@ -760,7 +807,9 @@ void KEYBOARD_Initialize(void)
     controller.leds = 0;
 
     PROFILE_Initialize(initialProfileData);
+    KEYBOARD_LoadKanaLayout();
     controller.profile = PROFILE_GetCurrent();
+    controller.switching = false;
 
     // Initialize key matrix:
     for (int i = 0; i < MATRIX_COLS; ++i) {
@@ -787,53 +836,137 @@ void KEYBOARD_Initialize(void)
 #endif
 }
 
+// Queue the keys newly pressed while a macro is being played behind the
+// keys still in the macro queue. Kana and Fn macros are queued by GetReport().
+static void CaptureReport(void)
+{
+    uint8_t buf[KEYBOARD_REPORT_LEN];
+
+    int8_t xmit = GetReport(buf, KEYBOARD_REPORT_LEN, &controller.cc);
+#if APP_HAS_MOUSE_INTERFACE
+    if (TSAP_IsTouched()) {
+        memset(buf + 2, 0, KEYBOARD_REPORT_LEN - 2);
+    }
+#endif
+    if (xmit == XMIT_NORMAL) {
+        for (int i = 2; i < KEYBOARD_REPORT_LEN && buf[i]; ++i) {
+            if (!memchr(controller.captured + 2, buf[i], KEYBOARD_REPORT_LEN - 2)) {
+                if (!MACRO_PutStep(buf[0], buf[i])) {
+                    // The macro queue is full. Leave the key unconsumed so
+                    // that it is reported as it is after the macro.
+                    break;
+                }
+                AddConsumedKey(buf[i]);
+            }
+        }
+    }
+    memmove(controller.captured, buf, KEYBOARD_REPORT_LEN);
+}
+
+// Do not press again the keys that have been typed through the macro queue
+// until they are released.
+static void RemoveConsumedKeys(uint8_t* buf)
+{
+    for (int i = 0; i < sizeof controller.consumed; ++i) {
+        uint8_t key = controller.consumed[i];
+        if (!key) {
+            continue;
+        }
+        uint8_t* p = memchr(buf + 2, key, KEYBOARD_REPORT_LEN - 2);
+        if (p) {
+            memmove(p, p + 1, buf + KEYBOARD_REPORT_LEN - p - 1);
+            buf[KEYBOARD_REPORT_LEN - 1] = 0;
+        } else {
+            controller.consumed[i] = 0;
+        }
+    }
+}
+
+// Discards the input state for the previous host, which the reset used to
+// clear before the hosts could be switched in place.
+static void ResetInput(void)
+{
+    MACRO_Clear();
+    KEYBOARD_ResetKana();
+    controller.xmit = XMIT_NONE;
+    controller.holding = false;
+    memset(controller.captured, 0, KEYBOARD_REPORT_LEN);
+    memset(controller.consumed, 0, sizeof controller.consumed);
+    controller.kana = false;
+    controller.prefix = 0;
+    controller.dualRoleFN = 0;
+}
+
+static bool CanSwitchProfileInPlace(uint8_t from, uint8_t to)
+{
+    // A reset is required to move between the USB and Bluetooth main loops.
+    if (from == PROFILE_INDEX_USB || to == PROFILE_INDEX_USB) {
+        return false;
+    }
+    return !USB_MODE_Get() && HOS_IsModuleInstalled();
+}
+
 bool KEYBOARD_Task(void)
 {
     KEYBOARD_UpdateLEDs();
     if (PROFILE_GetCurrent() != controller.profile) {
+        if (!CanSwitchProfileInPlace(PROFILE_GetCurrent(), controller.profile)) {
+            PROFILE_Select(controller.profile);
+            NVIC_SystemReset();
+            // NOT REACHED HERE
+        }
+        // Switching between Bluetooth hosts does not need a reset; HOS_MainLoop()
+        // notices the profile mismatch and lets the BLE module switch the host.
         PROFILE_Select(controller.profile);
-        NVIC_SystemReset();
-        // NOT REACHED HERE
+#if APP_HAS_MOUSE_INTERFACE
+        TSAP_Reset();
+#endif
+        ResetInput();
+        controller.switching = true;
     }
-    if (controller.xmit != XMIT_IN_ORDER) {
+    if (controller.switching) {
+        // Keep scanning, but hold the reports back so that no key goes to the
+        // previous host. The keys still held are reported once the module
+        // has switched to the new host.
         KEYBOARD_ScanMatrix();
-        if (!KEYBOARD_ProcessMatrix()) {
+        KEYBOARD_ProcessMatrix();
+        if (HOS_GetProfile() != PROFILE_GetCurrent()) {
             return false;
         }
-        controller.xmit = GetReport(controller.report, KEYBOARD_REPORT_LEN, &controller.cc);
-#if APP_HAS_MOUSE_INTERFACE
-        if (controller.xmit == XMIT_NORMAL && TSAP_IsTouched()) {
-            memset(controller.report + 2, 0, KEYBOARD_REPORT_LEN - 2);
+        // Report the keys held down to the new host.
+        controller.switching = false;
+    } else {
+        KEYBOARD_ScanMatrix();
+        if (controller.xmit == XMIT_IN_ORDER) {
+            // Keep sampling the keys while the macro is being played.
+            if (KEYBOARD_ProcessMatrix()) {
+                CaptureReport();
+            }
+            return true;
+        }
+        if (!KEYBOARD_ProcessMatrix()) {
+            // Type the kana held for a dakuten once the lookahead has passed.
+            if (KEYBOARD_FlushKana(false)) {
+                controller.xmit = XMIT_IN_ORDER;
+                memmove(controller.captured, controller.report, KEYBOARD_REPORT_LEN);
+                return true;
+            }
+            return false;
         }
-#endif
-    }
-    return true;
-}
-
-bool KEYBOARD_GetMacroReport(uint8_t* preport) {
-    if (controller.xmit != XMIT_IN_ORDER) {
-        return false;
     }
-    memmove(controller.reportPrev, controller.report, KEYBOARD_REPORT_LEN);
-    uint8_t key = MACRO_Peek();
-    uint8_t mod = 0;
-    if (KEYBOARD_IsModifier(key)) {
-        mod = 1u << (key - KEY_LEFT_CONTROL);
-        MACRO_Get();
-        key = MACRO_Peek();
-    }
-    if (controller.reportPrev[2] && controller.report[2] == key) {
-        // break the current key press
-        controller.report[0] = 0;
-        controller.report[2] = 0;
+    controller.xmit = GetReport(controller.report, KEYBOARD_REPORT_LEN, &controller.cc);
+    if (controller.xmit == XMIT_IN_ORDER) {
+        memmove(controller.captured, controller.report, KEYBOARD_REPORT_LEN);
+        // The keys are typed through the macro queue.
+        memset(controller.report + 2, 0, KEYBOARD_REPORT_LEN - 2);
     } else {
-        MACRO_Get();
-        controller.report[0] = mod;
-        controller.report[2] = key;
-        if (!key)
-            controller.xmit = XMIT_NORMAL;
+        RemoveConsumedKeys(controller.report);
     }
-    memmove(preport, controller.report, KEYBOARD_REPORT_LEN);
+#if APP_HAS_MOUSE_INTERFACE
+    if (controller.xmit == XMIT_NORMAL && TSAP_IsTouched()) {
+        memset(controller.report + 2, 0, KEYBOARD_REPORT_LEN - 2);
+    }
+#endif
     return true;
 }
 
@@ -870,24 +1003,80 @@ static void ToggleKanaMode(uint8_t* preport)
     }
 }
 
+// Records the keys newly pressed in the report to be sent.
+static void RecordReport(void)
+{
+    for (int i = 2; i < KEYBOARD_REPORT_LEN; ++i) {
+        uint8_t key = controller.report[i];
+        if (key && !memchr(controller.reportPrev + 2, key, KEYBOARD_REPORT_LEN - 2)) {
+            RECORDER_Put(controller.report[0], key);
+        }
+    }
+}
+
+// Spacing between the reports of a macro in the safe pace [msec]. The IMEs
+// on the Mac and the 109 key layouts are slow to follow the language keys.
+static const uint8_t paceSafe[OS_MAX + 1] = {
+    8,  // OS_PC
+    24, // OS_MAC
+    16, // OS_104A
+    16, // OS_104B
+    16, // OS_109
+    16, // OS_109A
+    16, // OS_109B
+    16, // OS_ALT_SP
+    16, // OS_SHIFT_SP
+    16, // OS_CTRL_SP
+    16, // OS_CAPS
+};
+
+// A report queued to the BLE module is sent at the next connection event.
+// The interval does not back off on retries, as the HOS master, which must
+// stay unmodified for the Bluetooth qualification, does not report them.
+#define PACE_HOS_INTERVAL   8   // [msec]
+
+static bool IsHOSTransport(void)
+{
+    return !USB_MODE_Get() && HOS_IsModuleInstalled() && !PROFILE_IsUSBMode();
+}
+
+static uint32_t GetPaceInterval(void)
+{
+    uint32_t msec = 0;
+
+    if (IsHOSTransport()) {
+        msec = PACE_HOS_INTERVAL;
+    }
+    if (PROFILE_Read(EEPROM_PACE) == PACE_SAFE) {
+        uint8_t os = PROFILE_Read(EEPROM_OS);
+        if (os <= OS_MAX) {
+            msec += paceSafe[os];
+        }
+    }
+    return 1000u * msec;
+}
+
 bool KEYBOARD_GetReport(uint8_t* preport)
 {
     if (controller.xmit == XMIT_IN_ORDER) {
-        uint8_t key = MACRO_Peek();
-        uint8_t mod = 0;
+        MACRO_STEP step = MACRO_Peek();
 
-        if (KEYBOARD_IsModifier(key)) {
-            mod = 1u << (key - KEY_LEFT_CONTROL);
-            MACRO_Get();
-            key = MACRO_Peek();
+        if (controller.holding) {
+            if ((int32_t) (APP_GetMicroseconds() - controller.holdUntil) < 0) {
+                return false;
+            }
+            controller.holding = false;
         }
+        // Different keys are sent make-to-make; a key repeated in the
+        // next step needs exactly one break in between.
+        uint8_t key = MACRO_STEP_KEY(step);
         if (controller.reportPrev[2] && controller.report[2] == key) {
             // break the current key press
             controller.report[0] = 0;
             controller.report[2] = 0;
         } else {
             MACRO_Get();
-            controller.report[0] = mod;
+            controller.report[0] = MACRO_STEP_MODIFIERS(step);
             controller.report[2] = key;
             if (!key) {
                 controller.xmit = XMIT_NORMAL;
@@ -895,9 +1084,19 @@ bool KEYBOARD_GetReport(uint8_t* preport)
         }
     }
     if (memcmp(controller.reportPrev, controller.report, KEYBOARD_REPORT_LEN)) {
+        if (RECORDER_IsRecording()) {
+            RecordReport();
+        }
         memmove(controller.reportPrev, controller.report, KEYBOARD_REPORT_LEN);
         memmove(preport, controller.report, KEYBOARD_REPORT_LEN);
         ToggleKanaMode(preport);
+        if (controller.xmit == XMIT_IN_ORDER) {
+            uint32_t interval = GetPaceInterval();
+            if (interval) {
+                controller.holding = true;
+                controller.holdUntil = APP_GetMicroseconds() + interval;
+            }
+        }
         return true;
     }
     return false;
@@ -43,6 +43,10 @@
 #define EEPROM_IME          6
 #define EEPROM_MOUSE        7
 #define EEPROM_PREFIX       8
+#define EEPROM_PACE         9
+#define EEPROM_KANA_OUTPUT  10
+#define EEPROM_LOOKAHEAD    11
+#define EEPROM_CHORD        12
 
 #define BASE_QWERTY         0
 #define BASE_DVORAK         1
@@ -63,7 +67,8 @@ static inline bool KEYBOARD_IsJapanese(uint8_t layout) {
 #define KANA_X6004          4
 #define KANA_MTYPE          5
 #define KANA_NEW_STICKNEY   6
-#define KANA_MAX            6
+#define KANA_USER           7   // loaded from the flash
+#define KANA_MAX            7
 
 #define OS_PC               0   // No language keys
 #define OS_MAC              1   // Kana / Eisuu
@@ -142,6 +147,26 @@ static inline bool KEYBOARD_IsMacMod(uint8_t mod) {
 #define PREFIXSHIFT_LED     2
 #define PREFIXSHIFT_MAX     2
 
+#define PACE_FAST           0   // as fast as the transport accepts reports
+#define PACE_SAFE           1   // spaced out for slow hosts and remote desktops
+#define PACE_MAX            1
+
+#define KANA_OUTPUT_ROMAJI  0   // for the IMEs in the romaji input mode
+#define KANA_OUTPUT_JIS     1   // for the IMEs in the JIS kana input mode
+#define KANA_OUTPUT_MAX     1
+
+#define LOOKAHEAD_OFF       0
+#define LOOKAHEAD_100       1   // hold a kana for a dakuten up to 100 msec
+#define LOOKAHEAD_200       2
+#define LOOKAHEAD_300       3
+#define LOOKAHEAD_MAX       3
+
+#define CHORD_OFF           0   // the thumb keys work as plain shift keys
+#define CHORD_50            1   // NICOLA chords within 50 msec
+#define CHORD_75            2
+#define CHORD_100           3
+#define CHORD_MAX           3
+
 //
 // SAM D21 User Row Addresses
 //
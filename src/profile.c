@@ -19,7 +19,10 @@
 #include "profile.h"
 #include "eeprom.h"
 
-#define VERSION     1
+#define VERSION     2
+
+// Version 1 kept 10 bytes per profile.
+#define PROFILE_DATA_SIZE_V1    10
 
 typedef struct __attribute__((__packed__)) {
     uint8_t data[PROFILE_DATA_SIZE];
@@ -42,11 +45,31 @@ static bool IsValidPage(const PROFILE_PAGE* page)
     return true;
 }
 
+// Spreads the version 1 profiles over the larger data and fills the new
+// settings with their initial values.
+static bool MigratePage(const uint8_t* initialData)
+{
+    uint8_t* page = (uint8_t*) &cache;
+    size_t end = PROFILE_DATA_SIZE_V1 * (PROFILE_INDEX_MAX + 1);
+
+    if (page[end + 1] != 1 || PROFILE_INDEX_MAX < page[end])
+        return false;
+    uint8_t current = page[end];
+    for (int i = PROFILE_INDEX_MAX; 0 <= i; --i) {
+        memmove(cache.profiles[i].data, page + PROFILE_DATA_SIZE_V1 * i, PROFILE_DATA_SIZE_V1);
+        memcpy(cache.profiles[i].data + PROFILE_DATA_SIZE_V1, initialData + PROFILE_DATA_SIZE_V1,
+               PROFILE_DATA_SIZE - PROFILE_DATA_SIZE_V1);
+    }
+    cache.currentProfile = current;
+    cache.version = VERSION;
+    return true;
+}
+
 void PROFILE_Initialize(const void* initialData)
 {
     EEPROM_Initialize();
     EEPROM_Read(0, &cache, sizeof(cache));
-    if (!IsValidPage(&cache)) {
+    if (!IsValidPage(&cache) && !MigratePage(initialData)) {
         cache.version = VERSION;
         cache.currentProfile = 0;
         for (int i = 0; i <= PROFILE_INDEX_MAX; ++i) {
@@ -20,7 +20,7 @@
 #include <stdbool.h>
 #include <stdint.h>
 
-#define PROFILE_DATA_SIZE   10
+#define PROFILE_DATA_SIZE   14
 
 #define PROFILE_INDEX_USB   0
 #define PROFILE_INDEX_BLE1  1
@@ -0,0 +1,171 @@
+/*
+ * Copyright 2013-2025 Esrille Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "app.h"
+
+// Each slot owns a few flash rows, and a recorded macro is written to the row
+// next to the latest one so that the erase cycles are spread over the rows.
+
+#define PAGE_SIZE       NVMCTRL_FLASH_PAGESIZE      // 64 bytes
+#define ROW_SIZE        NVMCTRL_FLASH_ROWSIZE       // 256 bytes
+#define ROWS_PER_SLOT   (RECORDER_SIZE / ROW_SIZE / RECORDER_SLOTS)
+#define ROW_MAGIC       0x4d                        // 'M'
+#define MAX_STEPS       ((ROW_SIZE - 4) / sizeof(MACRO_STEP))
+
+typedef struct __attribute__((__packed__)) {
+    uint8_t magic;
+    uint8_t seq;    // incremented at each write, wraps around
+    uint8_t count;  // number of steps
+    uint8_t reserved;
+    MACRO_STEP steps[MAX_STEPS];
+} RECORDER_ROW;
+
+typedef struct {
+    bool recording;
+    uint8_t slot;
+    RECORDER_ROW __attribute__((aligned(NVMCTRL_FLASH_PAGESIZE))) row;
+} RECORDER_CONTROL;
+
+static RECORDER_CONTROL recorder;
+
+static uint32_t GetRowAddress(uint8_t slot, uint8_t row)
+{
+    return RECORDER_ADDRESS + ROW_SIZE * (ROWS_PER_SLOT * slot + row);
+}
+
+static void Read(void* buffer, uint32_t size, uint32_t addr)
+{
+    while (NVMCTRL_IsBusy())
+        ;
+    NVMCTRL_ErrorGet();
+    NVMCTRL_Read(buffer, size, addr);
+}
+
+// Returns the row of the latest macro in the slot, or -1 if none is stored.
+static int8_t FindLatestRow(uint8_t slot, uint8_t* seq)
+{
+    int8_t latest = -1;
+    uint8_t header[4];
+
+    for (uint8_t i = 0; i < ROWS_PER_SLOT; ++i) {
+        Read(header, sizeof header, GetRowAddress(slot, i));
+        if (header[0] != ROW_MAGIC) {
+            continue;
+        }
+        if (latest < 0 || 0 < (int8_t) (header[1] - *seq)) {
+            latest = i;
+            *seq = header[1];
+        }
+    }
+    return latest;
+}
+
+bool RECORDER_IsRecording(void)
+{
+    return recorder.recording;
+}
+
+void RECORDER_Start(uint8_t slot)
+{
+    if (RECORDER_SLOTS <= slot) {
+        return;
+    }
+    recorder.recording = true;
+    recorder.slot = slot;
+    recorder.row.count = 0;
+}
+
+void RECORDER_Stop(void)
+{
+    uint8_t seq = 0;
+    uint32_t addr;
+    bool state;
+
+    if (!recorder.recording) {
+        return;
+    }
+    recorder.recording = false;
+
+    int8_t row = FindLatestRow(recorder.slot, &seq);
+    if (0 <= row) {
+        ++seq;
+        row = (row + 1) % ROWS_PER_SLOT;
+    } else {
+        row = 0;
+    }
+    recorder.row.magic = ROW_MAGIC;
+    recorder.row.seq = seq;
+    recorder.row.reserved = 0xff;
+    memset(recorder.row.steps + recorder.row.count, 0xff,
+           sizeof(MACRO_STEP) * (MAX_STEPS - recorder.row.count));
+
+    addr = GetRowAddress(recorder.slot, row);
+    state = NVIC_INT_Disable();
+    while (NVMCTRL_IsBusy())
+        ;
+    NVMCTRL_ErrorGet();
+    NVMCTRL_RowErase(addr);
+    // Write the page with the header last so that an interrupted write
+    // leaves the previous macro in effect.
+    for (int i = ROW_SIZE / PAGE_SIZE - 1; 0 <= i; --i) {
+        while (NVMCTRL_IsBusy())
+            ;
+        NVMCTRL_ErrorGet();
+        NVMCTRL_PageWrite((void*) ((uint8_t*) &recorder.row + PAGE_SIZE * i), addr + PAGE_SIZE * i);
+    }
+    NVIC_INT_Restore(state);
+}
+
+void RECORDER_Put(uint8_t modifiers, uint8_t key)
+{
+    if (recorder.recording && key && recorder.row.count < MAX_STEPS) {
+        recorder.row.steps[recorder.row.count++] = MACRO_STEP_MAKE(modifiers, key);
+    }
+}
+
+// Loads the macro in the slot page by page into the macro queue.
+bool RECORDER_Play(uint8_t slot)
+{
+    uint8_t seq = 0;
+    uint8_t count;
+    MACRO_STEP steps[PAGE_SIZE / sizeof(MACRO_STEP)];
+
+    if (RECORDER_SLOTS <= slot) {
+        return false;
+    }
+    int8_t row = FindLatestRow(slot, &seq);
+    if (row < 0) {
+        return false;
+    }
+    uint32_t addr = GetRowAddress(slot, row);
+    Read(&count, 1, addr + offsetof(RECORDER_ROW, count));
+    if (MAX_STEPS < count) {
+        return false;
+    }
+    addr += offsetof(RECORDER_ROW, steps);
+    for (uint8_t i = 0; i < count; addr += sizeof steps) {
+        // Do not read past the steps stored in the row.
+        uint32_t size = sizeof(MACRO_STEP) * (count - i);
+        if (sizeof steps < size) {
+            size = sizeof steps;
+        }
+        Read(steps, size, addr);
+        for (uint8_t j = 0; j < PAGE_SIZE / sizeof(MACRO_STEP) && i < count; ++j, ++i) {
+            MACRO_PutStep(MACRO_STEP_MODIFIERS(steps[j]), MACRO_STEP_KEY(steps[j]));
+        }
+    }
+    return 0 < count;
+}
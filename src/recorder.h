@@ -0,0 +1,35 @@
+/*
+ * Copyright 2013-2025 Esrille Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef ESRILLE_RECORDER_H
+#define ESRILLE_RECORDER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "eeprom.h"
+
+#define RECORDER_SLOTS      2
+#define RECORDER_SIZE       2048    // just below the NVRAM
+#define RECORDER_ADDRESS    (NVRAM_ADDRESS - RECORDER_SIZE)
+
+bool RECORDER_IsRecording(void);
+void RECORDER_Start(uint8_t slot);
+void RECORDER_Stop(void);
+void RECORDER_Put(uint8_t modifiers, uint8_t key);
+bool RECORDER_Play(uint8_t slot);
+
+#endif  // ESRILLE_RECORDER_H
@@ -18,19 +18,41 @@
 
 #define XY_DEAD_ZONE        24
 #define XY_RANGE            (128 - XY_DEAD_ZONE)
-#define TOUCH_DELAY         12      // a very short touch should be ignored.
+#define TOUCH_DELAY         12      // a very short, weak touch should be ignored.
 #define TOUCH_THRESH        1000
 #define TOUCH_MAX           4095
 #define TOUCH_RAMP_LIMIT    100
 
+#define XY_MAX              127     // maximum deflection per axis
+#define R_MAX               180     // > sqrt(2) * XY_MAX
+
+// The pointer motion is accumulated in Q22 report counts.
+#define COUNT_SHIFT         22
+#define COUNT_LIMIT         ((int32_t) (2 * 127) << COUNT_SHIFT)
+
+// In the scroll mode, the stick deflection is accumulated in Q22 high
+// resolution wheel counts, i.e., 1/MOUSE_WHEEL_MULTIPLIER of a detent.
+#define WHEEL_SHIFT         3       // log2(MOUSE_WHEEL_MULTIPLIER)
+#define SCROLL_DIVISOR      16      // pointer counts per high resolution wheel count
+
+// Keep scrolling for a while after the scroll mode ends.
+#ifndef TSAP_SCROLL_MOMENTUM
+#define TSAP_SCROLL_MOMENTUM    1
+#endif
+#define MOMENTUM_DIVISOR    32      // decay per sample
+#define MOMENTUM_MIN        (1 << (COUNT_SHIFT - 6))
+
+#define TSAP_FRAME_SIZE     4
+#define RX_BUFFER_SIZE      64      // must be a power of two
+
 typedef struct {
     uint8_t x;
     uint8_t y;
 } POSITION;
 
 typedef struct {
-    int16_t x;
-    int16_t y;
+    int32_t x;
+    int32_t y;
 } SCALED_POSITION;
 
 typedef struct {
@@ -45,6 +67,7 @@ typedef struct {
     uint16_t thresh;
     uint16_t high;
     uint16_t max;
+    uint16_t cusum;
     uint8_t  delay;
 } TOUCH_SENSOR;
 
@@ -55,9 +78,17 @@ typedef struct {
     POSITION        center;
     POSITION        rawPrev;
     SCALED_POSITION scaledPosition;
-    bool            aim;
-    uint8_t         mouse[MOUSE_REPORT_LEN];
-    uint8_t         mousePrev[MOUSE_REPORT_LEN];
+    SCALED_POSITION scroll;
+#if TSAP_SCROLL_MOMENTUM
+    SCALED_POSITION velocity;
+#endif
+    uint16_t        curve[R_MAX];
+    bool            scrolling;
+    uint8_t         buttons;
+    int16_t         x;
+    int16_t         y;
+    uint8_t         mouse[MOUSE_USB_REPORT_LEN];
+    uint8_t         mousePrev[MOUSE_USB_REPORT_LEN];
     int8_t          wheel;
 } TSAP_CONTROL;
 
@@ -65,33 +96,155 @@ static const uint8_t aboutTSAP[] = {
     KEY_P, KEY_A, KEY_D, KEY_SPACE, 0
 };
 
+// Counts of the stick deflection per report count for each PAD_SENSE_* level
+static const uint16_t curveGains[PAD_SENSE_MAX + 1] = {
+    4 * XY_RANGE, 3 * XY_RANGE, 2 * XY_RANGE, 1 * XY_RANGE
+};
+
 static TSAP_CONTROL controller;
 
+// The Resolution Multiplier set by the host, which is kept over TSAP_Reset()
+// as the host does not set it again after a USB resume.
+static uint8_t feature;
+
+// Return the fraction of the deflection past the dead zone along the radius
+// in Q15. The pointer speed is the square of the scaled deflection.
+static uint16_t CurveShape(uint8_t r)
+{
+    if (r <= XY_DEAD_ZONE) {
+        return 0;
+    }
+    return ((uint32_t) (r - XY_DEAD_ZONE) << 15) / r;
+}
+
+// Precompute the transfer curve so that ProcessSerialData() needs neither
+// divisions nor the dead zone test per sample.
+static void LoadCurve(void)
+{
+    uint16_t gain = curveGains[controller.resolution];
+
+    for (uint8_t r = 0; r < R_MAX; ++r) {
+        uint32_t shape = CurveShape(r);
+        controller.curve[r] = ((shape * shape) / gain) >> (30 - COUNT_SHIFT);
+    }
+}
+
 static void LoadResolution(void)
 {
     controller.resolution = PROFILE_Read(EEPROM_MOUSE);
     if (PAD_SENSE_MAX < controller.resolution) {
         controller.resolution = 0;
     }
+    LoadCurve();
 }
 
 static void SetResolution(uint8_t val)
 {
-    controller.resolution = (PAD_SENSE_MAX < val) ? 0 : val;
-    PROFILE_Write(EEPROM_MOUSE, controller.resolution);
+    val = (PAD_SENSE_MAX < val) ? 0 : val;
+    if (val != controller.resolution) {
+        controller.resolution = val;
+        LoadCurve();
+        PROFILE_Write(EEPROM_MOUSE, controller.resolution);
+    }
+}
+
+static int32_t ClampCount(int32_t count)
+{
+    if (count < -COUNT_LIMIT) {
+        return -COUNT_LIMIT;
+    }
+    if (COUNT_LIMIT < count) {
+        return COUNT_LIMIT;
+    }
+    return count;
+}
+
+// Take the whole report counts out of the accumulated motion, truncating toward
+// zero so that the remainder is carried over to the next report.
+static int16_t TakeCount(int32_t* count, uint8_t shift, int16_t limit)
+{
+    int32_t n = (*count < 0) ? -(-*count >> shift) : (*count >> shift);
+
+    if (n < -limit) {
+        n = -limit;
+    } else if (limit < n) {
+        n = limit;
+    }
+    *count -= n << shift;
+    return n;
+}
+
+// Return the shift to take wheel counts, which are in detents unless the host
+// has enabled the Resolution Multiplier.
+static uint8_t GetWheelShift(uint8_t enabled)
+{
+    return (feature & enabled) ? COUNT_SHIFT : (COUNT_SHIFT + WHEEL_SHIFT);
+}
+
+static void Scroll(int32_t dx, int32_t dy)
+{
+    controller.scroll.x = ClampCount(controller.scroll.x + dx);
+    controller.scroll.y = ClampCount(controller.scroll.y + dy);
+#if TSAP_SCROLL_MOMENTUM
+    // Track the recent scroll speed per sample.
+    controller.velocity.x += (dx - controller.velocity.x) / 4;
+    controller.velocity.y += (dy - controller.velocity.y) / 4;
+#endif
 }
 
+#if TSAP_SCROLL_MOMENTUM
+static void Coast(void)
+{
+    if (controller.velocity.x || controller.velocity.y) {
+        controller.scroll.x = ClampCount(controller.scroll.x + controller.velocity.x);
+        controller.scroll.y = ClampCount(controller.scroll.y + controller.velocity.y);
+        controller.velocity.x -= controller.velocity.x / MOMENTUM_DIVISOR;
+        controller.velocity.y -= controller.velocity.y / MOMENTUM_DIVISOR;
+        if (-MOMENTUM_MIN < controller.velocity.x && controller.velocity.x < MOMENTUM_MIN &&
+                -MOMENTUM_MIN < controller.velocity.y && controller.velocity.y < MOMENTUM_MIN) {
+            controller.velocity.x = controller.velocity.y = 0;
+        }
+    }
+}
+#endif
+
 static uint8_t GetDistance(uint8_t raw, uint8_t center)
 {
     return (raw < center) ? (center - raw) : (raw - center);
 }
 
-// Return 0.75 * prev + (1 - 0.75) * raw
-static uint16_t LowPassFilter(uint16_t prev, uint16_t raw)
+// Follow a falling touch value (a finger landing) by half of the step, and a
+// rising one (a finger leaving) by a quarter of the step.
+static uint16_t TouchFilter(uint16_t prev, uint16_t raw)
+{
+    if (raw < prev) {
+        return prev - ((prev - raw + 1) >> 1);
+    }
+    return prev + ((raw - prev) >> 2);
+}
+
+// Accumulate how far the raw touch values fall below the threshold (CUSUM).
+// A firm touch crosses the limit within a few samples, while a light brush
+// that barely dips below the threshold drains away by the allowance.
+static bool DetectTouch(uint16_t touch)
 {
-    prev -= (prev >> 2);
-    raw >>= 2;
-    return prev + raw;
+    uint16_t margin = controller.touchSensor.high - controller.touchSensor.thresh;
+    uint16_t allowance = margin >> 3;
+    uint32_t cusum = controller.touchSensor.cusum;
+
+    if (margin == 0) {
+        return false;
+    }
+    if (touch < controller.touchSensor.thresh) {
+        cusum += controller.touchSensor.thresh - touch;
+    }
+    cusum = (allowance < cusum) ? (cusum - allowance) : 0;
+    if (2u * margin <= cusum) {
+        controller.touchSensor.cusum = 2u * margin;
+        return true;
+    }
+    controller.touchSensor.cusum = cusum;
+    return false;
 }
 
 static void ProcessSerialData(void)
@@ -113,16 +266,19 @@ static void ProcessSerialData(void)
         controller.touchSensor.max = touch;
     }
 
-    controller.touchSensor.current = LowPassFilter(controller.touchSensor.current, touch);
+    controller.touchSensor.current = TouchFilter(controller.touchSensor.current, touch);
     if (controller.touchSensor.high < controller.touchSensor.current) {
         controller.touchSensor.high = controller.touchSensor.current;
         controller.touchSensor.thresh = (controller.touchSensor.high * 5) / 7;
     }
     if (controller.touchSensor.current < controller.touchSensor.thresh) { // touched?
-        if (controller.touchSensor.delay < TOUCH_DELAY) {
+        if (DetectTouch(touch)) {
+            controller.touchSensor.delay = TOUCH_DELAY;
+        } else if (controller.touchSensor.delay < TOUCH_DELAY) {
             ++controller.touchSensor.delay;
         }
     } else {
+        controller.touchSensor.cusum = 0;
         if ((GetDistance(controller.rawData.x, 128u) < XY_DEAD_ZONE &&
                 GetDistance(controller.rawData.y, 128u) < XY_DEAD_ZONE) ||
                 (controller.center.x == 0 && controller.center.y == 0)) {
@@ -141,7 +297,9 @@ static void ProcessSerialData(void)
         controller.touchSensor.delay = 0;
     }
 
+    controller.scrolling = false;
     if (TSAP_IsTouched()) {
+        controller.scrolling = KEYBOARD_IsKeyPressed(KEY_SEMICOLON);
         if (KEYBOARD_IsKeyPressed(KEY_I) || KEYBOARD_IsKeyPressed(KEY_D)) {
             controller.wheel = 1;
         } else if (KEYBOARD_IsKeyPressed(KEY_K) || KEYBOARD_IsKeyPressed(KEY_C)) {
@@ -164,19 +322,33 @@ static void ProcessSerialData(void)
         sign_y = -1;
         y = -y;
     }
+    if (XY_MAX < x) {
+        x = XY_MAX;
+    }
+    if (XY_MAX < y) {
+        y = XY_MAX;
+    }
     uint16_t r = isqrt16(x * x + y * y);
-    if (r <= XY_DEAD_ZONE) {
-        x = y = 0;
+    int32_t gain = controller.curve[r];
+
+    int32_t dx = sign_x * (x * x) * gain;
+    int32_t dy = sign_y * (y * y) * gain;
+
+    if (controller.scrolling) {
+        // Pushing the stick forward scrolls up.
+        Scroll(dx / SCROLL_DIVISOR, -dy / SCROLL_DIVISOR);
     } else {
-        x = x * (r - XY_DEAD_ZONE) / r;
-        y = y * (r - XY_DEAD_ZONE) / r;
-        x *= x;
-        y *= y;
+        controller.scaledPosition.x = ClampCount(controller.scaledPosition.x + dx);
+        controller.scaledPosition.y = ClampCount(controller.scaledPosition.y + dy);
+#if TSAP_SCROLL_MOMENTUM
+        if (TSAP_IsTouched()) {
+            controller.velocity.x = controller.velocity.y = 0;
+        } else {
+            Coast();
+        }
+#endif
     }
 
-    controller.scaledPosition.x += sign_x * x;
-    controller.scaledPosition.y += sign_y * y;
-
     controller.rawPrev.x = controller.rawData.x;
     controller.rawPrev.y = controller.rawData.y;
 }
@@ -236,7 +408,13 @@ bool TSAP_IsTouched(void)
     return false;
 }
 
-static char receiveBuffer[1];
+// SERCOM4 still takes an RXC interrupt for each octet, but the read callback
+// runs once per frame and only copies the frame into a ring buffer, which is
+// drained and decoded later in the task context by TSAP_Poll().
+static uint8_t receiveBuffer[TSAP_FRAME_SIZE];
+static uint8_t rxBuffer[RX_BUFFER_SIZE];
+static volatile uint8_t rxHead;
+static volatile uint8_t rxTail;
 
 void TSAP_ReadCallback(uintptr_t context)
 {
@@ -244,11 +422,36 @@ void TSAP_ReadCallback(uintptr_t context)
         //Handle error case
     } else {
         //Transfer completed successfully
-        ProcessOctet(receiveBuffer[0]);
+        uint8_t head = rxHead;
+        for (int i = 0; i < TSAP_FRAME_SIZE; ++i) {
+            uint8_t next = (head + 1) & (RX_BUFFER_SIZE - 1);
+            if (next == rxTail) {
+                break;  // overrun; ProcessOctet() resyncs at the next start bit.
+            }
+            rxBuffer[head] = receiveBuffer[i];
+            head = next;
+        }
+        rxHead = head;
     }
     SERCOM4_USART_Read(receiveBuffer, sizeof receiveBuffer);
 }
 
+void TSAP_Poll(void)
+{
+    uint8_t tail = rxTail;
+
+    while (tail != rxHead) {
+        ProcessOctet(rxBuffer[tail]);
+        tail = (tail + 1) & (RX_BUFFER_SIZE - 1);
+    }
+    rxTail = tail;
+}
+
+bool TSAP_IsIdle(void)
+{
+    return rxTail == rxHead;
+}
+
 void TSAP_Reset(void)
 {
     bool interruptStatus = NVIC_INT_Disable();
@@ -270,7 +473,8 @@ void TSAP_Initialize2(void)
     SERCOM4_USART_Read(receiveBuffer, sizeof receiveBuffer);
 }
 
-bool MOUSE_GetReport(uint8_t* preport)
+// Update the buttons and the motion to report, allowing up to limit counts per axis.
+static void UpdateMouse(int16_t limit)
 {
     if (TSAP_IsTouched()) {
         uint8_t buttons = 0;
@@ -294,34 +498,71 @@ bool MOUSE_GetReport(uint8_t* preport)
         } else if (KEYBOARD_IsKeyPressed(KEY_O) || KEYBOARD_IsKeyPressed(KEY_B)) {
             buttons |= MOUSE_BUTTON_FORWARD;
         }
-        controller.aim = KEYBOARD_IsKeyPressed(KEY_SEMICOLON);
-        controller.mouse[0] = buttons;
+        controller.buttons = buttons;
         bool interruptStatus = NVIC_INT_Disable();
-        int16_t x = controller.scaledPosition.x;
-        int16_t y = controller.scaledPosition.y;
-        int16_t gain = XY_RANGE * (4 - controller.resolution);
-        x /= gain;
-        y /= gain;
-        controller.scaledPosition.x -= gain * x;
-        controller.scaledPosition.y -= gain * y;
-        controller.mouse[3] = controller.wheel;
+        controller.x = TakeCount(&controller.scaledPosition.x, COUNT_SHIFT, limit);
+        controller.y = TakeCount(&controller.scaledPosition.y, COUNT_SHIFT, limit);
+        controller.scroll.y = ClampCount(controller.scroll.y + ((int32_t) controller.wheel << (COUNT_SHIFT + WHEEL_SHIFT)));
         controller.wheel = 0;
         NVIC_INT_Restore(interruptStatus);
-        controller.mouse[1] = x;
-        controller.mouse[2] = y;
     } else {
-        controller.aim = false;
-        memset(controller.mouse, 0, MOUSE_REPORT_LEN);
+        controller.buttons = 0;
+        controller.x = controller.y = 0;
+        controller.wheel = 0;
     }
+}
 
-    if (controller.mouse[1] || controller.mouse[2] || controller.mouse[3] || memcmp(controller.mouse, controller.mousePrev, MOUSE_REPORT_LEN)) {
-        memmove(preport, controller.mouse, MOUSE_REPORT_LEN);
-        memmove(controller.mousePrev, controller.mouse, MOUSE_REPORT_LEN);
+static bool UpdateReport(uint8_t* preport, uint8_t len)
+{
+    bool moved = false;
+
+    for (uint8_t i = 1; i < len; ++i) {
+        if (controller.mouse[i]) {
+            moved = true;
+        }
+    }
+    if (moved || memcmp(controller.mouse, controller.mousePrev, len)) {
+        memmove(preport, controller.mouse, len);
+        memmove(controller.mousePrev, controller.mouse, len);
         return true;
     }
     return false;
 }
 
+bool MOUSE_GetReport(uint8_t* preport)
+{
+    UpdateMouse(127);
+    controller.mouse[0] = controller.buttons;
+    controller.mouse[1] = controller.x;
+    controller.mouse[2] = controller.y;
+    controller.mouse[3] = TakeCount(&controller.scroll.y, COUNT_SHIFT + WHEEL_SHIFT, 127);
+    controller.scroll.x = 0;    // no horizontal wheel in this report
+    return UpdateReport(preport, MOUSE_REPORT_LEN);
+}
+
+bool MOUSE_GetUSBReport(uint8_t* preport)
+{
+    UpdateMouse(INT16_MAX);
+    controller.mouse[0] = controller.buttons;
+    controller.mouse[1] = controller.x;
+    controller.mouse[2] = controller.x >> 8;
+    controller.mouse[3] = controller.y;
+    controller.mouse[4] = controller.y >> 8;
+    controller.mouse[5] = TakeCount(&controller.scroll.y, GetWheelShift(MOUSE_FEATURE_WHEEL), 127);
+    controller.mouse[6] = TakeCount(&controller.scroll.x, GetWheelShift(MOUSE_FEATURE_PAN), 127);
+    return UpdateReport(preport, MOUSE_USB_REPORT_LEN);
+}
+
+uint8_t MOUSE_GetFeature(void)
+{
+    return feature;
+}
+
+void MOUSE_SetFeature(uint8_t value)
+{
+    feature = value & (MOUSE_FEATURE_WHEEL | MOUSE_FEATURE_PAN);
+}
+
 void MOUSE_About(void)
 {
     MACRO_Puts(aboutTSAP);
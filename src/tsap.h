@@ -24,6 +24,8 @@ void TSAP_Reset(void);
 void TSAP_Initialize1(void);
 void TSAP_Initialize2(void);    // for USB mode
 void TSAP_Task(uint8_t x, uint8_t y, uint16_t touch);
+void TSAP_Poll(void);          // for USB mode
+bool TSAP_IsIdle(void);         // for USB mode
 bool TSAP_IsTouched(void);
 
 #endif  // ESRILLE_TSAP_H